@@ -0,0 +1,229 @@
+/*
+	shipxb11
+	Copyright (C) 2022 Craig McPartland
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* The engine's own declarations. Programs using the engine include shipxb11.h. */
+
+#ifndef SHIPXB11_ENGINE_H
+#define SHIPXB11_ENGINE_H
+
+#include "game.h"
+#include <limits.h>
+#include <time.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
+#if defined(PROFILER)
+#define PROFILE_BEGIN(game, phase) begin_phase(game, phase)
+#define PROFILE_END(game, phase) end_phase(game, phase)
+#define PROFILE_FRAME(game) end_profile_frame(game)
+#define TRACE_BEGIN(game, name, detail) trace_event(game, name, detail, 'B')
+#define TRACE_END(game, name) trace_event(game, name, NULL, 'E')
+#else
+#define PROFILE_BEGIN(game, phase)
+#define PROFILE_END(game, phase)
+#define PROFILE_FRAME(game)
+#define TRACE_BEGIN(game, name, detail)
+#define TRACE_END(game, name)
+#endif
+
+static int check_dimensions(Game *);
+static Uint64 split_mix(Uint64 *);
+static void seed_random(Random *, Uint64, int);
+static Uint64 next_random(Random *);
+static Uint32 random_bits(Game *, int);
+static double random_unit(Game *, int);
+static Uint64 mask_bits(const Uint64 *, int, int);
+static SDL_bool pixels_overlap(const Sprite *, int, double, double, const Sprite *, int, double, double);
+static void initialise_atlas(Game *);
+static int add_atlas_page(Game *);
+static SDL_bool reserve_atlas_space(Atlas *, SDL_Surface **, int, SDL_Rect *);
+static int add_to_atlas(Game *, Sprite *, SDL_Surface **, int);
+static int upload_atlas(Game *);
+static void free_atlas(Atlas *);
+static void start_decoding_images(Game *);
+static int decode_images(void *);
+static SDL_bool take_decoded_image(ImageCache *, const char *, SDL_Surface **);
+static void finish_decoding_images(Game *);
+static SDL_Surface *load_image_with_index(Game *, const char *, unsigned int);
+static void set_sprite_width_height(Sprite *, SDL_Surface *);
+static void build_sprite_mask(Game *, Sprite *, SDL_Surface **, int);
+static void set_sprite_defaults(Sprite *);
+static void set_vertex(SDL_Vertex *, float, float, float, float);
+static double interpolate(Game *, double, double);
+static void place_sprite(Sprite *, double, double);
+static void draw_frame(Game *, const Sprite *, int, double, double);
+static void draw_sprite(Game *, const Sprite *);
+static void animate_sprite(Sprite *);
+static int initialise_sprite(Game *, Sprite *, const char *);
+static void draw_background(Game *);
+static void scroll_background(Game *);
+static int initialise_sdl(Game *);
+static void initialise_craft(Craft *);
+static void reset_player(Game *);
+static void kill_asteroid(Game *);
+static void reset_bigblue(Game *);
+static int initialise_bigblue(Game *);
+static int initialise_player(Game *);
+static void initialise_alien_store(Game *);
+static void free_alien_store(Aliens *);
+static void initialise_grid(Game *);
+static void free_grid(Grid *);
+static int initialise_alien_type(Game *, int, const char *);
+static void update_live_aliens(Aliens *);
+static void reset_aliens(Game *);
+static int initialise_aliens(Game *);
+static int initialise_explosion(Game *);
+static int initialise_missile(Game *);
+static int initialise_player_missile(Game *);
+static void reset_asteroid(Game *);
+static int initialise_line(Game *);
+static void reset_asteroid_quarters(Game *);
+static int initialise_asteroid_quarters(Game *);
+static int initialise_sprites(Game *);
+static void stop_animation(Sprite *);
+static void explosion_position(Game *, int, double *, double *);
+static void start_explosion(Game *, Craft *, int);
+static void finish_explosion(Game *, Craft *, int);
+static void remove_explosion(Explosions *, int);
+static void stop_explosions(Game *, Craft *);
+static void explode(Game *, Craft *);
+static void explode_alien(Game *, int);
+static void update_explosions(Game *);
+static void initialise_particles(Particles *);
+static int emit_particle(Game *, int, double, double, double, double, int);
+static void emit_sparks(Game *, double, double);
+static void clear_particles(Particles *);
+static void release_debris(Particles *);
+static void integrate_particles(Particles *);
+static void cull_particles(Game *);
+static void update_particles(Game *);
+static void particle_sprite(Game *, int, Sprite *);
+static void initialise_projectiles(Projectiles *);
+static int spawn_projectile(Game *, int, double, double, double, int);
+static void release_projectile(Game *, int);
+static void release_projectiles(Game *, int);
+static Sprite *projectile_template(Game *, int);
+static void projectile_sprite(Game *, int, Sprite *);
+static void create_scene_textures(Game *);
+static void begin_scene(Game *);
+static void end_scene(Game *);
+static void create_pause_screen(Game *);
+static void recapture_pause_screen(Game *);
+static int handle_key_down(Game *, SDL_Event *);
+static int handle_key_up(Game *, SDL_Event *);
+static int handle_event(Game *, SDL_Event *);
+static int handle_events(Game *);
+static void write_varint(FILE *, Uint64);
+static Uint64 read_varint(FILE *);
+static void write_run(Replay *);
+static void apply_replay_input(Game *, Uint8);
+static void next_input(Game *);
+static void discard_replay(Game *);
+static void record_key_press(Game *, SDL_Event *);
+static void present_frame(Game *);
+static int compare_samples(const void *, const void *);
+#if defined(PROFILER)
+static void initialise_profiler(Profiler *);
+static void end_profile_frame(Game *);
+static void profile_stats(Profiler *, int, Uint32 *, double *, Uint32 *);
+static void draw_profiler(Game *);
+static void free_profiler(Profiler *);
+static void begin_phase(Game *, int);
+static void end_phase(Game *, int);
+static void trace_event(Game *, const char *, const char *, char);
+static void add_trace_event(Tracer *, const char *, const char *, char, Uint64, int);
+static void write_json_string(FILE *, const char *);
+static int write_trace(void *);
+static void hand_off_trace(Tracer *);
+#endif
+static void get_texture_dimensions(SDL_Texture *, int *, int *);
+static SDL_Texture *create_text_texture(Game *, char *);
+static int create_text_textures(Game *);
+static void draw_lives(Game *);
+static void draw_score_digits(Game *);
+static void draw_high_score_digits(Game *);
+static void update_scores(Game *);
+static void draw_scores(Game *);
+static void create_hud_texture(Game *);
+static SDL_bool hud_is_stale(Game *);
+static void render_hud(Game *);
+static void draw_hud(Game *);
+static void draw_explosions(Game *);
+static void draw_aliens(Game *);
+static void draw_projectiles(Game *);
+static void draw_particles(Game *);
+static int render_graphics(Game *);
+static void animate_visible_sprite(Sprite *);
+static void animate_alien(Game *, int);
+static void update_animations(Game *);
+static void move_big_blue_missiles(Game *);
+static void move_bigblue(Game *);
+static void level_up(Game *);
+static void move_alien_missiles(Game *);
+static int grid_cell(int, int);
+static Uint64 intersect_boxes_scalar(const Boxes *, int, int, const double *);
+#if defined(__SSE2__)
+static Uint64 intersect_boxes_sse2(const Boxes *, int, int, const double *);
+#endif
+#if defined(HAVE_AVX2_KERNEL)
+static Uint64 intersect_boxes_avx2(const Boxes *, int, int, const double *);
+#endif
+static void set_query_box(double *, Sprite *);
+static void build_grid(Game *);
+static void grid_range(Game *, Sprite *, SDL_Rect *);
+static SDL_bool alien_pixels_overlap(Game *, int, Sprite *);
+static SDL_bool check_if_shot_hit_aliens(Game *, int);
+static void check_if_shots_hit_aliens(Game *);
+static void check_if_quarter_hit_aliens(Game *, Sprite *);
+static void check_if_quarters_hit_aliens(Game *);
+static void check_if_shots_hit_asteroid(Game *);
+static SDL_bool check_if_alien_missile_hit_player(Game *, int);
+static void move_alien_ship(Game *, int);
+static void fire_alien_ship_missile(Game *, int);
+static void move_player(Game *);
+static SDL_bool check_if_shot_hit_bigblue(Game *, int);
+static void check_if_quarter_hit_bigblue(Game *, Sprite *);
+static void check_if_quarters_hit_bigblue(Game *);
+static void move_player_shots(Game *);
+static void move_asteroid(Game *);
+static void move_graphics(Game *);
+static void show_game_over_message(Game *);
+static void bring_on_big_blue_at_random(Game *);
+static void bring_on_asteroid_at_random(Game *);
+static void bring_on_others_at_random(Game *);
+static void save_position(Sprite *);
+static void save_positions(Game *);
+static void show_paused_message(Game *);
+static void initialise_pacer(FramePacer *, int);
+static void wait_for_next_frame(FramePacer *);
+static void draw_pause_screen(Game *);
+static SDL_bool event_needs_redraw(SDL_Event *);
+static SDL_bool animate_pause_screen(Game *);
+static int wait_while_paused(Game *);
+static double time_box_kernel(BoxKernel, const Boxes *, const double *);
+static int initialise_textures(Game *);
+static void free_sprite(Sprite *);
+
+#endif
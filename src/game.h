@@ -0,0 +1,435 @@
+/*
+	shipxb11
+	Copyright (C) 2022 Craig McPartland
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* The engine's data structures, shared with the benchmarks that time its parts. */
+
+#ifndef SHIPXB11_GAME_H
+#define SHIPXB11_GAME_H
+
+#include "shipxb11.h"
+#include <SDL2/SDL_video.h>
+#include <SDL2/SDL_image.h>
+#include <SDL2/SDL2_rotozoom.h>
+#include <SDL2/SDL_ttf.h>
+
+#define ALIEN_EXPLODING 0x2
+#define ALIEN_MISSILE 0x4
+#define ALIEN_TYPE 4
+#define ALIEN_VISIBLE 0x1
+#define ATLAS_PADDING 1
+#define ATLAS_SIZE 2048
+#define BATCH_QUADS 512
+#define BENCH_BOXES 4096
+#define BENCH_QUADS 1000000
+#define BENCH_QUERIES 20000
+#define BENCH_SECONDS 0.5 /* Minimum run time of each simulation benchmark. */
+#define BENCH_SOUNDS 200
+#define DECODE_THREADS 8
+#define FPS 60
+#define GRID_CELL 64
+#define HEIGHT 800
+#define INPUT_END 0x80 /* Marks the trailer after the last run. */
+#define INPUT_FIRE 0x10 /* One missile, counted in the INPUT_FIRES bits. */
+#define INPUT_FIRES 0x70
+#define INPUT_RESTART 0x8
+#define INTERPOLATION_LIMIT 32
+#define LATENCY_SAMPLES 4096
+#define LEFT_KEY 0x4
+#define LINE_Y 70
+#define MASK_ALPHA 128
+#define MAX_ATLAS_PAGES 4
+#define MAX_DEBRIS 64 /* Particle slots kept for asteroid quarters, sparks never take them. */
+#define MAX_EXPLOSIONS 256
+#define MAX_IMAGES 256
+#define MAX_PARTICLES 2048
+#define MAX_PENDING_KEYS 64
+#define MAX_PROJECTILES 1024
+#define MAX_SOUNDS 1
+#define MAX_TICKS_PER_FRAME 5
+#define NO_KEY 0
+#define PACER_SPIN_MICROSECONDS 500
+#define PARTICLE_BUDGET_MICROSECONDS 200
+#define PARTICLE_SPARK 4 /* Kinds below this are asteroid quarters. */
+#define PARTICLE_SPARKS 16
+#define PAUSE_MSG 5
+#define PROFILE_BACKGROUND 1
+#define PROFILE_EVENTS 0
+#define PROFILE_MOVE 4
+#define PROFILE_NAMES { "events", "background", "render", "spawn", "move", "particles", "present", "wait" }
+#define PROFILE_PARTICLES 5
+#define PROFILE_PHASES 8
+#define PROFILE_PRESENT 6
+#define PROFILE_REFRESH 30 /* Frames between overlay updates. */
+#define PROFILE_RENDER 2
+#define PROFILE_SAMPLES 1024
+#define PROFILE_SPAWN 3
+#define PROFILE_WAIT 7
+#define PROJECTILE_ALIEN 1
+#define PROJECTILE_BIGBLUE 2
+#define PROJECTILE_KINDS 3
+#define PROJECTILE_PLAYER 0
+#define RANDOM_ALIENS 0 /* Independent generator streams, one per subsystem. */
+#define RANDOM_ASTEROID 1
+#define RANDOM_BIGBLUE 2
+#define RANDOM_PARTICLES 3
+#define RANDOM_STREAMS 4
+#define REPLAY_MAGIC "SXBR"
+#define REPLAY_VERSION 2
+#define RIGHT_KEY 0x1
+#define SPRITE_ALIENS 2 /* Indices into sprite_files. The alien types and the quarters are consecutive. */
+#define SPRITE_ASTEROID 12
+#define SPRITE_BACKGROUND 6
+#define SPRITE_BIGBLUE 0
+#define SPRITE_BIGBLUE_MISSILES 11
+#define SPRITE_EXPLOSION 7
+#define SPRITE_LINE 10
+#define SPRITE_MISSILE 8
+#define SPRITE_PLAYER 1
+#define SPRITE_PLAYER_MISSILE 9
+#define SPRITE_QUARTERS 13
+#define SPRITES 17
+#define TICK_RATE 60
+#define TRACE_DECODE_TID 2 /* Decode worker n is traced as thread TRACE_DECODE_TID + n, the main thread as 1. */
+#define TRACE_EVENTS 16384 /* Per buffer. One fills while the other is written. */
+#define WIDTH 600
+
+#define set_rect(R, X, Y, W, H) R.x = X; R.y = Y; R.w = W; R.h = H
+
+typedef struct {
+	SDL_AudioSpec audio_spec;
+	SDL_bool converted;
+	Uint8 *wave_buffer;
+	Uint32 wave_length;
+} AudioInfo;
+
+typedef struct {
+	SDL_bool playing;
+	AudioInfo audio_info[MAX_SOUNDS];
+	SDL_AudioDeviceID id;
+	SDL_AudioSpec device_spec;
+	unsigned int index;
+} Audio;
+
+typedef struct { /* Sprite frames packed into a few large textures. */
+	int page_count;
+	int width;
+	int height;
+	int x; /* Next free position on the last page's current shelf. */
+	int y;
+	int shelf_height;
+	SDL_Surface *surface[MAX_ATLAS_PAGES]; /* Only until the pages are uploaded. */
+	SDL_Texture *texture[MAX_ATLAS_PAGES];
+} Atlas;
+
+typedef struct { /* Image files decoded on worker threads while the main thread sets up. */
+	int count;
+	int thread_count;
+	SDL_atomic_t next; /* Next file for a worker to decode. */
+	SDL_mutex *lock;
+	SDL_cond *decoded;
+	SDL_Thread *thread[DECODE_THREADS];
+	char *name[MAX_IMAGES];
+	SDL_Surface *surface[MAX_IMAGES];
+	SDL_bool ready[MAX_IMAGES];
+#if defined(PROFILER)
+	SDL_atomic_t workers; /* Numbers the workers for the trace. */
+	const char *file[MAX_IMAGES]; /* Sprite each image is a frame of. */
+	int worker[MAX_IMAGES];
+	Uint64 decode_start[MAX_IMAGES]; /* Timed on the workers, traced once they are done. */
+	Uint64 decode_end[MAX_IMAGES];
+#endif
+} ImageCache;
+
+typedef struct { /* Quads sharing a texture, drawn with one SDL_RenderGeometry() call. */
+	SDL_Texture *texture;
+	int texture_width;
+	int texture_height;
+	int quad_count;
+	SDL_Vertex vertex[BATCH_QUADS * 4];
+	int index[BATCH_QUADS * 6];
+} SpriteBatch;
+
+typedef struct {
+	Uint64 deadline;
+	Uint64 period;
+	Uint64 spin; /* Busy-wait this long before the deadline instead of sleeping. */
+} FramePacer;
+
+typedef struct {
+	SDL_bool enabled;
+	int pending_count;
+	Uint64 pending[MAX_PENDING_KEYS]; /* When key presses not yet presented happened. */
+	Uint64 pending_tick[MAX_PENDING_KEYS]; /* The tick count at each press, it is shown once a later tick has run. */
+	Uint64 ticks;
+	unsigned int sample_count;
+	Uint32 sample[LATENCY_SAMPLES]; /* Key press to present, in microseconds. */
+} Latency;
+
+#if defined(PROFILER)
+typedef struct {
+	SDL_bool visible; /* F3 toggles the overlay. */
+	const char *path; /* Written on exit, as JSON if it ends in .json and CSV otherwise. */
+	unsigned int frame_count;
+	Uint64 start[PROFILE_PHASES];
+	Uint64 ticks[PROFILE_PHASES]; /* This frame so far, as the update phases can run more than once. */
+	Uint32 sample[PROFILE_PHASES][PROFILE_SAMPLES]; /* Nanoseconds per frame. */
+	SDL_Texture *line[PROFILE_PHASES];
+} Profiler;
+
+typedef struct {
+	const char *name;
+	const char *detail; /* Written as args.detail when not NULL, or args.name for metadata. */
+	Uint64 time;
+	int tid;
+	char phase; /* 'B', 'E' or 'M'. */
+} TraceEvent;
+
+typedef struct { /* Chrome trace_event JSON, written on its own thread. */
+	FILE *file;
+	const char *path;
+	SDL_Thread *thread;
+	SDL_sem *full; /* Posted when a buffer is handed to the writer. */
+	SDL_sem *empty; /* Posted when the writer is done with it. */
+	SDL_bool quit;
+	int current; /* Buffer being filled. */
+	int count[2];
+	int writing; /* Buffer being written. */
+	Uint64 start;
+	TraceEvent *event[2];
+} Tracer;
+#endif
+
+typedef struct { /* Per tick input, run length encoded. */
+	FILE *file;
+	const char *path;
+	int mode;
+	SDL_bool finished;
+	Uint8 pending; /* Missiles fired and restart since the last tick. */
+	Uint8 state; /* Input for the current run. */
+	Uint64 run; /* Ticks recorded in, or left to replay of, the current run. */
+	Uint64 ticks;
+	Uint64 recorded_ticks; /* From the trailer, to check the replay against. */
+	Uint64 recorded_score;
+} Replay;
+
+typedef struct {
+	SDL_bool is_exploding;
+	SDL_bool missile_is_launched;
+	int missile_x;
+	int missile_y;
+	int previous_missile_y;
+	unsigned int key;
+	int hit_time; /* Ticks Big Blue has been flashing since it was hit. */
+	int target_x; /* Where the player is steering to. */
+	unsigned int launcher; /* Which of the player's launchers fires next. */
+	Sprite sprite;
+} Craft;
+
+typedef struct { /* One array per field, indexed by slot, type by type. */
+	int capacity; /* Slots allocated, enough for a full wave. */
+	int count; /* Slots in play, alien_type rows of alien_count. */
+	int live_count;
+	void *pool; /* Single allocation the arrays below are carved from. */
+	double *x;
+	double *y;
+	double *dx;
+	double *dy;
+	double *previous_x;
+	double *previous_y;
+	int *live; /* Visible slots in ascending order. */
+	int *width;
+	int *height;
+	int *current_frame;
+	int *next_frame_time;
+	Uint8 *flags;
+	Uint8 *type;
+} Aliens;
+
+typedef struct { /* Fixed pool of missiles, recycled through a free stack. */
+	int count;
+	int free_count;
+	int kind_count[PROJECTILE_KINDS];
+	int live[MAX_PROJECTILES];
+	int live_index[MAX_PROJECTILES]; /* Where each slot is in live. */
+	int free[MAX_PROJECTILES];
+	int owner[MAX_PROJECTILES]; /* Alien slot that fired it, or -1. */
+	Uint8 kind[MAX_PROJECTILES];
+	double x[MAX_PROJECTILES];
+	double y[MAX_PROJECTILES];
+	double dy[MAX_PROJECTILES];
+	double previous_y[MAX_PROJECTILES];
+} Projectiles;
+
+typedef struct { /* Packed alien boxes for the intersection kernels. */
+	double *left;
+	double *top;
+	double *right;
+	double *bottom;
+} Boxes;
+
+typedef Uint64 (*BoxKernel)(const Boxes *, int, int, const double *);
+
+typedef struct { /* Uniform grid over the playfield, rebuilt each tick. */
+	int columns;
+	int rows;
+	int max_width; /* Largest alien, so queries reach aliens from neighbouring cells. */
+	int max_height;
+	int *cell; /* Cell of each slot. */
+	int *cell_start; /* Aliens in cell c are entry[cell_start[c]] to entry[cell_start[c + 1] - 1]. */
+	int *entry;
+	Boxes boxes; /* Box of each entry. */
+	BoxKernel intersect;
+	const char *kernel_name;
+	unsigned long pairs_tested; /* This tick. */
+	unsigned long total_pairs;
+} Grid;
+
+typedef struct {
+	int score_digit[7];
+	int high_digit[7];
+	int high;
+	int score;
+	int visible_high;
+	int visible_score;
+	int char_width[10];
+	int char_height[10];
+	SDL_Texture *digit_texture[10];
+} Score;
+
+typedef struct { /* Scores and lives, redrawn only when they change. */
+	SDL_bool is_valid;
+	int high;
+	int lives;
+	int score;
+	SDL_Texture *texture;
+} Hud;
+
+typedef struct { /* xoshiro256** state. */
+	Uint64 s[4];
+} Random;
+
+typedef struct { /* Asteroid quarters and sparks, compacted each tick. */
+	int count;
+	int debris_count; /* Quarters, which can hit things. */
+	SDL_bool over_budget; /* Last update ran long, so hold back sparks. Only sparks, as it depends on timing. */
+	Uint64 update_ticks;
+	Uint64 max_ticks;
+	Uint64 total_ticks;
+	unsigned long updates;
+	double x[MAX_PARTICLES];
+	double y[MAX_PARTICLES];
+	double dx[MAX_PARTICLES];
+	double dy[MAX_PARTICLES];
+	double previous_x[MAX_PARTICLES];
+	double previous_y[MAX_PARTICLES];
+	int life[MAX_PARTICLES]; /* Ticks left, or -1 to last until it leaves the playfield. */
+	Uint8 kind[MAX_PARTICLES];
+} Particles;
+
+typedef struct { /* Explosions in progress, all drawing the shared explosion frames. */
+	int count;
+	int alien[MAX_EXPLOSIONS]; /* Exploding alien slot when craft is NULL. */
+	Craft *craft[MAX_EXPLOSIONS];
+	int frame[MAX_EXPLOSIONS];
+	int next_frame_time[MAX_EXPLOSIONS];
+	double x[MAX_EXPLOSIONS];
+	double y[MAX_EXPLOSIONS];
+	double previous_x[MAX_EXPLOSIONS];
+	double previous_y[MAX_EXPLOSIONS];
+} Explosions;
+
+struct Game {
+	Atlas atlas;
+	Audio audio;
+	SDL_bool has_pause_screen;
+	SDL_bool headless;
+	SDL_bool paused;
+	SDL_bool vsync;
+	const char *title;
+	double alpha; /* Interpolation between the previous and current tick. */
+	double startup_milliseconds; /* Spent in initialise_game. */
+	Aliens aliens;
+	Grid grid;
+	ImageCache images;
+	Craft asteroid;
+	Craft bigblue;
+	Craft player;
+	Explosions explosions;
+	FramePacer pacer;
+	Hud hud;
+	Latency latency;
+	Particles particles;
+#if defined(PROFILER)
+	Profiler profiler;
+	Tracer tracer;
+#endif
+	Projectiles projectiles;
+	Random random[RANDOM_STREAMS];
+	Replay replay;
+	int alien_count;
+	int alien_type;
+	int fps;
+	int games; /* Started since launch. */
+	int height;
+	int level;
+	int lives;
+	int shot_limit; /* Player missiles in flight at once. */
+	int width;
+	unsigned long frames;
+	Uint64 seed;
+	Score score;
+	SpriteBatch batch;
+	Sprite alien_sprite[ALIEN_TYPE];
+	Sprite background;
+	Sprite explosion;
+	Sprite line;
+	Sprite missile;
+	Sprite big_blue_missiles;
+	Sprite cursor[2]; /* Pause screen copies, so pausing leaves the game's sprites alone. */
+	Sprite player_missile;
+	Sprite quarter[4];
+	SDL_Texture *game_over_message;
+	SDL_Texture *paused_message[PAUSE_MSG];
+	SDL_Texture *pause_screen;
+	SDL_Texture *scene; /* Frames are drawn here, then copied to the window. */
+	SDL_Renderer *renderer;
+	SDL_Window *window;
+	TTF_Font *font;
+};
+
+void initialise_audio(Game *);
+void close_audio(Game *);
+int load_audio(Game *, const char *);
+int initialise_game(Game *);
+void initialise_batch(SpriteBatch *);
+void flush_batch(Game *);
+void batch_copy(Game *, SDL_Texture *, const SDL_Rect *, const SDL_Rect *);
+int open_replay(Game *);
+void close_replay(Game *);
+void report_latency(Game *);
+#if defined(PROFILER)
+void export_profile(Game *);
+int open_trace(Game *);
+void close_trace(Game *);
+#endif
+void select_box_kernel(Grid *);
+int play_game(Game *);
+int run_headless(Game *);
+void free_graphics(Game *);
+
+#endif
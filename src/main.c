@@ -0,0 +1,107 @@
+/*
+	shipxb11
+	Copyright (C) 2022 Craig McPartland
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "shipxb11.h"
+
+static void print_usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [--headless] [--frames N] [--fps N] [--vsync] [--latency] [--aliens N] [--shots N] [--seed N] [--record FILE] [--replay FILE] [--bench-collision]\n", name);
+	fprintf(stderr, "  --headless  Run the game logic without a window, renderer or audio.\n");
+	fprintf(stderr, "  --frames N  Number of frames to simulate in headless mode (default %d).\n", HEADLESS_FRAMES);
+	fprintf(stderr, "  --fps N     Limit rendering to N frames per second, 0 for no limit (default display refresh rate).\n");
+	fprintf(stderr, "  --vsync     Let the display's vertical sync pace the frames.\n");
+	fprintf(stderr, "  --latency   Report key press to present latency on exit.\n");
+	fprintf(stderr, "  --aliens N  Number of aliens of each type in a wave (default %d).\n", ALIEN_POPULATION);
+	fprintf(stderr, "  --shots N   Player missiles in flight at once (default 1).\n");
+	fprintf(stderr, "  --seed N    Seed for the game's random number generators (default %d).\n", RANDOM_SEED);
+	fprintf(stderr, "  --record FILE  Save the seed and every tick's input to FILE.\n");
+	fprintf(stderr, "  --replay FILE  Play back a recording, headless at full speed or in the window.\n");
+#if defined(PROFILER)
+	fprintf(stderr, "  --profile FILE  Write per phase frame times to FILE on exit, as JSON if it ends in .json and CSV otherwise.\n");
+	fprintf(stderr, "  --trace FILE  Write a Chrome trace of frame phases, loading and audio to FILE.\n");
+#endif
+	fprintf(stderr, "  --bench-collision  Time the box intersection kernels and exit.\n");
+}
+
+static int parse_arguments(Options *options, int argc, char *argv[])
+{
+	set_default_options(options);
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--headless") == 0) {
+			options->headless = SDL_TRUE;
+		} else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			options->frames = strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+			options->fps = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--vsync") == 0) {
+			options->vsync = SDL_TRUE;
+		} else if (strcmp(argv[i], "--latency") == 0) {
+			options->latency = SDL_TRUE;
+		} else if (strcmp(argv[i], "--aliens") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			options->alien_count = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--shots") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			options->shot_limit = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			options->seed = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			options->replay_mode = REPLAY_RECORD;
+			options->replay_path = argv[++i];
+		} else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			options->replay_mode = REPLAY_PLAY;
+			options->replay_path = argv[++i];
+#if defined(PROFILER)
+		} else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+			options->profile_path = argv[++i];
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			options->trace_path = argv[++i];
+#endif
+		} else if (strcmp(argv[i], "--bench-collision") == 0) {
+			options->bench_collision = SDL_TRUE;
+		} else {
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	Options options;
+	int status = parse_arguments(&options, argc, argv);
+
+	if (status != 0) {
+		return 1;
+	}
+
+	Game *game = create_game(&options);
+
+	if (options.bench_collision) {
+		status = bench_collision(game);
+	} else if (start_game(game) == 0) {
+		status = run_game(game);
+		stop_game(game);
+	} else {
+		status = 1;
+	}
+
+	destroy_game(game);
+	return status;
+}
@@ -16,9 +16,29 @@
 	along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
-#include "shipxb11.h"
-
-static void initialise_audio(Game *game)
+#include "engine.h"
+
+static const char *const sprite_files[SPRITES] = { /* Indexed by SPRITE_*, and decoded ahead in this order. */
+	DATADIR"/bigblue.png",
+	DATADIR"/player.png",
+	DATADIR"/purple.png",
+	DATADIR"/green.png",
+	DATADIR"/yellow.png",
+	DATADIR"/cyan.png",
+	DATADIR"/background.jpg",
+	DATADIR"/explosion.png",
+	DATADIR"/missile.png",
+	DATADIR"/playmis.png",
+	DATADIR"/line.png",
+	DATADIR"/missiles.png",
+	DATADIR"/asteroid.png",
+	DATADIR"/ul.png",
+	DATADIR"/ur.png",
+	DATADIR"/ll.png",
+	DATADIR"/lr.png"
+};
+
+void initialise_audio(Game *game)
 {
 	SDL_AudioSpec obtained;
 	int status = 1;
@@ -59,7 +79,7 @@ static void initialise_audio(Game *game)
 	return;
 }
 
-static void close_audio(Game *game)
+void close_audio(Game *game)
 {
 	SDL_CloseAudioDevice(game->audio.id);
 
@@ -76,7 +96,7 @@ static void close_audio(Game *game)
 	}
 }
 
-static int load_audio(Game *game, const char *path)
+int load_audio(Game *game, const char *path)
 {
 	SDL_AudioCVT cvt;
 	SDL_AudioSpec *audio_spec;
@@ -124,8 +144,10 @@ static int check_dimensions(Game *game)
 	return 0;
 }
 
-static int initialise_game(Game *game)
+int initialise_game(Game *game)
 {
+	Uint64 start_time = SDL_GetPerformanceCounter();
+
 	for (int i = 0; i < 7; i++) {
 		game->score.high_digit[i] = 0;
 	}
@@ -134,7 +156,29 @@ static int initialise_game(Game *game)
 	game->title = GAME_TITLE;
 	game->score.visible_high = 0;
 	game->score.high = 0;
-	game->debris.quarters_remaining = 0;
+	game->audio.id = 0;
+	game->audio.index = 0;
+	game->audio.playing = SDL_FALSE;
+	game->width = WIDTH;
+	game->height = HEIGHT;
+
+	for (int i = 0; i < ALIEN_TYPE; i++) {
+		set_sprite_defaults(&game->alien_sprite[i]);
+	}
+
+	for (int i = 0; i < RANDOM_STREAMS; i++) {
+		seed_random(&game->random[i], game->seed, i);
+	}
+
+#if defined(PROFILER)
+	initialise_profiler(&game->profiler);
+#endif
+	initialise_projectiles(&game->projectiles);
+	initialise_particles(&game->particles);
+	game->explosions.count = 0;
+	initialise_alien_store(game);
+	initialise_grid(game);
+	game->games = 0;
 	reset_game(game);
 
 	int status = initialise_sdl(game);
@@ -143,9 +187,30 @@ static int initialise_game(Game *game)
 		return status;
 	}
 
+	TRACE_BEGIN(game, "start_decoding_images", NULL);
+	start_decoding_images(game); /* The workers decode while the window and renderer are created. */
+	TRACE_END(game, "start_decoding_images");
+
+	if (game->headless) {
+		game->width = WIDTH;
+		game->height = HEIGHT;
+		game->window = NULL;
+		game->renderer = NULL;
+		game->pause_screen = NULL;
+		game->scene = NULL;
+		game->has_pause_screen = SDL_FALSE;
+		game->game_over_message = NULL;
+		initialise_atlas(game);
+		status = initialise_sprites(game);
+		finish_decoding_images(game);
+		game->startup_milliseconds = (SDL_GetPerformanceCounter() - start_time) * 1000.0 / SDL_GetPerformanceFrequency();
+		return status;
+	}
+
 	status = check_dimensions(game);
 
 	if (status != 0) {
+		finish_decoding_images(game);
 		TTF_CloseFont(game->font);
 		TTF_Quit();
 		SDL_Quit();
@@ -157,17 +222,19 @@ static int initialise_game(Game *game)
 	if (game->window == NULL) {
 		fprintf(stderr, "%s: In function %s ", game->title, __func__);
 		fprintf(stderr, "SDL_CreateWindow failed. %s\n", SDL_GetError());
+		finish_decoding_images(game);
 		TTF_CloseFont(game->font);
 		TTF_Quit();
 		SDL_Quit();
 		return 1;
 	}
 
-	game->renderer = SDL_CreateRenderer(game->window, -1, 0);
+	game->renderer = SDL_CreateRenderer(game->window, -1, game->vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
 
 	if (game->renderer == NULL) {
 		fprintf(stderr, "%s: In function %s ", game->title, __func__);
 		fprintf(stderr, "SDL_CreateRenderer failed. %s\n", SDL_GetError());
+		finish_decoding_images(game);
 		SDL_DestroyWindow(game->window);
 		TTF_CloseFont(game->font);
 		TTF_Quit();
@@ -175,13 +242,28 @@ static int initialise_game(Game *game)
 		return 1;
 	}
 
+	SDL_RendererInfo info;
+
+	if (game->vsync && SDL_GetRendererInfo(game->renderer, &info) == 0 && (info.flags & SDL_RENDERER_PRESENTVSYNC)) {
+		game->fps = 0; /* SDL_RenderPresent() paces the frames. */
+	} else if (game->fps < 0) {
+		SDL_DisplayMode mode;
+		status = SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(game->window), &mode);
+		game->fps = (status == 0 && mode.refresh_rate > 0) ? mode.refresh_rate : FPS;
+	}
+
 	SDL_SetRenderDrawColor(game->renderer, 255, 255, 0, SDL_ALPHA_OPAQUE);
+	initialise_batch(&game->batch);
+	game->alpha = 1.0;
 	game->pause_screen = NULL;
+	game->scene = NULL;
+	game->has_pause_screen = SDL_FALSE;
 	game->game_over_message = NULL;
 
 	status = initialise_textures(game);
 
 	if (status != 0) {
+		finish_decoding_images(game);
 		SDL_DestroyRenderer(game->renderer);
 		SDL_DestroyWindow(game->window);
 		TTF_CloseFont(game->font);
@@ -190,622 +272,2177 @@ static int initialise_game(Game *game)
 		return status;
 	}
 
-	return initialise_sprites(game);
+	initialise_atlas(game);
+	status = initialise_sprites(game);
+	finish_decoding_images(game);
+
+	if (status == 0) { /* Only the texture uploads have to be on this thread. */
+		TRACE_BEGIN(game, "upload_atlas", NULL);
+		status = upload_atlas(game);
+		TRACE_END(game, "upload_atlas");
+	}
+
+	game->startup_milliseconds = (SDL_GetPerformanceCounter() - start_time) * 1000.0 / SDL_GetPerformanceFrequency();
+	return status;
 }
 
-static SDL_bool has_intersection(Sprite *s1, Sprite *s2)
+static Uint64 split_mix(Uint64 *state)
 {
-	return !(s2->x > (s1->x + s1->width) || (s2->x + s2->width) < s1->x || s2->y > (s1->y + s1->height) || (s2->y + s2->height) < s1->y);
+	Uint64 z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
 }
 
-static SDL_Surface *load_image_with_index(Game *game, char *path, unsigned int indx)
+static void seed_random(Random *random, Uint64 seed, int stream)
 {
-	SDL_Surface *surface = NULL;
-	size_t path_len = strlen(path) + 3;
-	char *ext = strrchr(path, '.');
-	char *filename = (char *)malloc(path_len * sizeof(char));
+	Uint64 state = seed ^ ((Uint64)stream << 56); /* Each stream starts from its own point. */
 
-	if (filename == NULL) {
-		fprintf(stderr, "%s: malloc returned NULL in function %s\n", game->title, __func__);
-		exit(1);
+	for (int i = 0; i < 4; i++) {
+		random->s[i] = split_mix(&state);
 	}
+}
 
-	snprintf(filename, path_len, "%.*s%02d%s", (int)(ext - path), path, indx, ext);
-	surface = IMG_Load(filename);
+static Uint64 next_random(Random *random)
+{
+	Uint64 *s = random->s;
+	Uint64 result = s[1] * 5;
+	result = ((result << 7) | (result >> 57)) * 9;
+	Uint64 t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = (s[3] << 45) | (s[3] >> 19);
+	return result;
+}
 
-	if (surface == NULL && indx == 0) {
-		fprintf(stderr, "%s: In function %s\n", game->title, __func__);
-		fprintf(stderr, "%s: Failed to load %s.\n", game->title, filename);
-	}
+static Uint32 random_bits(Game *game, int stream)
+{
+	return (Uint32)(next_random(&game->random[stream]) >> 32);
+}
 
-	free(filename);
-	return surface;
+static double random_unit(Game *game, int stream) /* In [0, 1). */
+{
+	return (next_random(&game->random[stream]) >> 11) * (1.0 / 9007199254740992.0);
 }
 
-static void set_sprite_width_height(Sprite *sprite)
+SDL_bool has_intersection(Sprite *s1, Sprite *s2)
 {
-	int acc, height, width;
-	Uint32 format;
-	SDL_QueryTexture(sprite->texture[0], &format, &acc, &width, &height);
-	sprite->width = width;
-	sprite->height = height;
+	return !(s2->x > (s1->x + s1->width) || (s2->x + s2->width) < s1->x || s2->y > (s1->y + s1->height) || (s2->y + s2->height) < s1->y);
 }
 
-static int load_sprite(Game *game, Sprite *sprite, char *path)
+static Uint64 mask_bits(const Uint64 *row, int words, int offset)
 {
-	int indx = 0;
-	SDL_Surface *surface;
+	if (offset <= -64 || offset >= words * 64) {
+		return 0;
+	}
 
-	while ((surface = load_image_with_index(game, path, indx)) != NULL) {
-		sprite->texture = realloc(sprite->texture, sizeof(SDL_Texture **) * (indx + 1));
+	if (offset < 0) {
+		return row[0] << -offset;
+	}
 
-		if (sprite->texture == NULL) {
-			fprintf(stderr, "%s: realloc returned NULL in function %s\n", game->title, __func__);
-			exit(1);
-		}
+	int word = offset / 64;
+	int shift = offset % 64;
+	Uint64 bits = row[word] >> shift;
 
-		sprite->texture[indx] = SDL_CreateTextureFromSurface(game->renderer, surface);
-		SDL_FreeSurface(surface);
+	if (shift != 0 && word + 1 < words) {
+		bits |= row[word + 1] << (64 - shift);
+	}
 
-		if (sprite->texture[indx] == NULL) {
-			for (int i = 0; i < indx; i++) {
-				SDL_DestroyTexture(sprite->texture[i]);
-			}
+	return bits;
+}
 
-			return 1;
-		}
+static SDL_bool pixels_overlap(const Sprite *a, int frame_a, double ax, double ay, const Sprite *b, int frame_b, double bx, double by)
+{
+	if (a->mask == NULL || b->mask == NULL) {
+		return SDL_TRUE;
+	}
 
-		indx++;
+	int dx = (int)bx - (int)ax;
+	int dy = (int)by - (int)ay;
+	int left = SDL_max(0, dx);
+	int right = SDL_min(a->width, dx + b->width);
+	int top = SDL_max(0, dy);
+	int bottom = SDL_min(a->height, dy + b->height);
+
+	if (left >= right) {
+		return SDL_FALSE;
 	}
 
-	if (indx == 0) {
-		return 1;
+	for (int y = top; y < bottom; y++) { /* Shift b's row onto a's words and AND them. */
+		const Uint64 *row_a = &a->mask[(frame_a * a->height + y) * a->mask_words];
+		const Uint64 *row_b = &b->mask[(frame_b * b->height + y - dy) * b->mask_words];
+
+		for (int word = left / 64; word <= (right - 1) / 64; word++) {
+			if (row_a[word] & mask_bits(row_b, b->mask_words, word * 64 - dx)) {
+				return SDL_TRUE;
+			}
+		}
 	}
 
-	set_sprite_width_height(sprite);
-	sprite->frame_count = indx - 1;
-	return 0;
+	return SDL_FALSE;
 }
 
-static void set_sprite_defaults(Sprite *sprite)
+SDL_bool sprites_collide(Sprite *s1, Sprite *s2)
 {
-	sprite->texture = NULL;
-	sprite->x = sprite->y = 0.0;
-	sprite->width = sprite->height = 0;
-	sprite->current_frame = sprite->frame_delay = sprite->next_frame_time = 0;
-	sprite->dx = sprite->dy = 0.0;
-	sprite->is_visible = SDL_FALSE;
-	sprite->is_animated = SDL_FALSE;
+	return has_intersection(s1, s2) && pixels_overlap(s1, s1->current_frame, s1->x, s1->y, s2, s2->current_frame, s2->x, s2->y);
 }
 
-static void copy_sprite(Game *game, Sprite *copy, Sprite *sprite)
+static void initialise_atlas(Game *game)
 {
-	int i = sprite->frame_count + 1;
-	set_sprite_defaults(copy);
-	copy->width = sprite->width;
-	copy->height = sprite->height;
-	copy->frame_count = sprite->frame_count;
-	copy->texture = (SDL_Texture **)malloc(sizeof(SDL_Texture *) * i);
+	SDL_RendererInfo info;
+	Atlas *atlas = &game->atlas;
+	atlas->page_count = 0;
+	atlas->width = atlas->height = ATLAS_SIZE;
 
-	if (copy->texture == NULL) {
-		fprintf(stderr, "%s: malloc returned NULL in function %s\n", game->title, __func__);
-		exit(1);
+	if (game->headless || SDL_GetRendererInfo(game->renderer, &info) != 0) {
+		return;
 	}
 
-	do {
-		i--;
-		copy->texture[i] = sprite->texture[i];
-	} while (i > 0);
-}
-
-static void draw_sprite(Game *game, Sprite *sprite)
-{
-	if (!sprite->is_visible) {
-		return ;
+	if (info.max_texture_width > 0 && info.max_texture_width < atlas->width) {
+		atlas->width = info.max_texture_width;
 	}
 
-	SDL_Rect drect = { (int)sprite->x, (int)sprite->y, sprite->width, sprite->height };
-	SDL_RenderCopy(game->renderer, sprite->texture[sprite->current_frame], NULL, &drect);
-
-	if (!sprite->is_animated) {
-		return;
+	if (info.max_texture_height > 0 && info.max_texture_height < atlas->height) {
+		atlas->height = info.max_texture_height;
 	}
+}
 
-	if (sprite->next_frame_time != 0) {
-		sprite->next_frame_time--;
-		return;
+static int add_atlas_page(Game *game)
+{
+	Atlas *atlas = &game->atlas;
+
+	if (atlas->page_count == MAX_ATLAS_PAGES) {
+		fprintf(stderr, "%s: In function %s, all %d atlas pages are full.\n", game->title, __func__, MAX_ATLAS_PAGES);
+		return 1;
 	}
 
-	sprite->next_frame_time = sprite->frame_delay;
+	SDL_Surface *page = SDL_CreateRGBSurfaceWithFormat(0, atlas->width, atlas->height, 32, SDL_PIXELFORMAT_ARGB8888);
 
-	if (sprite->current_frame < sprite->frame_count) {
-		sprite->current_frame++;
-	} else {
-		sprite->current_frame = 0;
+	if (page == NULL) {
+		fprintf(stderr, "%s: In function %s ", game->title, __func__);
+		fprintf(stderr, "SDL_CreateRGBSurfaceWithFormat failed. %s\n", SDL_GetError());
+		return 1;
 	}
-}
 
-static int initialise_sprite(Game *game, Sprite *sprite, char *image_path)
-{
-	set_sprite_defaults(sprite);
-	return load_sprite(game, sprite, image_path);
+	atlas->surface[atlas->page_count] = page;
+	atlas->texture[atlas->page_count] = NULL;
+	atlas->page_count++;
+	atlas->x = atlas->y = atlas->shelf_height = 0;
+	return 0;
 }
 
-static void draw_background(Game *game)
+static SDL_bool reserve_atlas_space(Atlas *atlas, SDL_Surface **surfaces, int count, SDL_Rect *rects)
 {
-	static int y;
-	SDL_Rect srect = { 0, 0, game->width, game->height - y };
-	SDL_Rect drect = { 0, y, game->width, game->height - y };
-	SDL_RenderCopy(game->renderer, game->background.texture[0], &srect, &drect);
-	set_rect(srect, 0, game->height - y, game->width, y);
-	set_rect(drect, 0, 0, game->width, y);
-	SDL_RenderCopy(game->renderer, game->background.texture[0], &srect, &drect);
-	y++;
+	int x = atlas->x;
+	int y = atlas->y;
+	int shelf_height = atlas->shelf_height;
+
+	for (int i = 0; i < count; i++) {
+		int width = surfaces[i]->w + ATLAS_PADDING;
+		int height = surfaces[i]->h + ATLAS_PADDING;
+
+		if (x + width > atlas->width) { /* Start a new shelf. */
+			x = 0;
+			y += shelf_height;
+			shelf_height = 0;
+		}
 
-	if (y == game->height) {
-		y = 0;
+		if (x + width > atlas->width || y + height > atlas->height) {
+			return SDL_FALSE;
+		}
+
+		set_rect(rects[i], x, y, surfaces[i]->w, surfaces[i]->h);
+		x += width;
+		shelf_height = SDL_max(shelf_height, height);
 	}
+
+	atlas->x = x;
+	atlas->y = y;
+	atlas->shelf_height = shelf_height;
+	return SDL_TRUE;
 }
 
-static int initialise_sdl(Game *game)
+static int add_to_atlas(Game *game, Sprite *sprite, SDL_Surface **surfaces, int count)
 {
-	int status = SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_EVENTS);
+	Atlas *atlas = &game->atlas;
 
-	if (status != 0) {
-		fprintf(stderr, "%s: In function %s ", game->title, __func__);
-		fprintf(stderr, "SDL_Init failed. %s\n", SDL_GetError());
-		return 1;
+	if (game->headless) { /* Nothing is drawn, only the frame sizes matter. */
+		for (int i = 0; i < count; i++) {
+			set_rect(sprite->frame[i], 0, 0, surfaces[i]->w, surfaces[i]->h);
+		}
+
+		sprite->page = -1;
+		return 0;
 	}
 
-	status = TTF_Init();
-	
-	if (status != 0) {
-		fprintf(stderr, "%s: In function %s ", game->title, __func__);
-		fprintf(stderr, "TTF_Init failed. %s\n", TTF_GetError());
-		SDL_Quit();
-		return 1;
+	if (atlas->page_count == 0 || !reserve_atlas_space(atlas, surfaces, count, sprite->frame)) {
+		if (add_atlas_page(game) != 0) {
+			return 1;
+		}
+
+		if (!reserve_atlas_space(atlas, surfaces, count, sprite->frame)) {
+			fprintf(stderr, "%s: In function %s, sprite frames do not fit on a %d x %d atlas page.\n", game->title, __func__, atlas->width, atlas->height);
+			return 1;
+		}
 	}
 
-	game->font = TTF_OpenFont(DATADIR"/BigBottomCartoon.ttf", 18);
-	
-	if (game->font == NULL) {
-		fprintf(stderr, "%s: In function %s ", game->title, __func__);
-		fprintf(stderr, "Failed to open font. %s\n", TTF_GetError());
-		TTF_Quit();
-		SDL_Quit();
-		return 1;
+	sprite->page = atlas->page_count - 1;
+
+	for (int i = 0; i < count; i++) {
+		SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE); /* Copy the alpha channel as is. */
+		SDL_BlitSurface(surfaces[i], NULL, atlas->surface[sprite->page], &sprite->frame[i]);
 	}
 
 	return 0;
 }
 
-static void initialise_craft(Craft *craft)
+static int upload_atlas(Game *game)
 {
-	craft->is_exploding = SDL_FALSE;
-	craft->missile_is_launched = SDL_FALSE;
-}
+	Atlas *atlas = &game->atlas;
 
-static void reset_player(Game *game)
-{
-	game->player_missile.x = game->player_missile.y = 0;
-	game->player_missile.is_visible = SDL_FALSE;
-	game->player.sprite.is_visible = SDL_TRUE;
+	for (int i = 0; i < atlas->page_count; i++) {
+		atlas->texture[i] = SDL_CreateTextureFromSurface(game->renderer, atlas->surface[i]);
+		SDL_FreeSurface(atlas->surface[i]);
+		atlas->surface[i] = NULL;
+
+		if (atlas->texture[i] == NULL) {
+			fprintf(stderr, "%s: In function %s ", game->title, __func__);
+			fprintf(stderr, "SDL_CreateTextureFromSurface failed. %s\n", SDL_GetError());
+			return 1;
+		}
+	}
+
+	return 0;
 }
 
-static void kill_asteroid(Game *game)
+static void free_atlas(Atlas *atlas)
 {
-	game->asteroid.sprite.is_visible = SDL_FALSE;
-	game->asteroid.is_exploding = SDL_FALSE;
-	game->debris.upper_left.sprite.is_visible = SDL_FALSE;
-	game->debris.upper_right.sprite.is_visible = SDL_FALSE;
-	game->debris.lower_left.sprite.is_visible = SDL_FALSE;
-	game->debris.lower_right.sprite.is_visible = SDL_FALSE;
+	for (int i = 0; i < atlas->page_count; i++) {
+		if (atlas->surface[i] != NULL) {
+			SDL_FreeSurface(atlas->surface[i]);
+		}
+
+		if (atlas->texture[i] != NULL) {
+			SDL_DestroyTexture(atlas->texture[i]);
+		}
+	}
+
+	atlas->page_count = 0;
 }
 
-static void reset_bigblue(Game *game)
+static void start_decoding_images(Game *game)
 {
-	initialise_craft(&game->bigblue);
-	game->big_blue_missiles.is_visible = SDL_FALSE;
-	game->bigblue.sprite.is_visible = SDL_FALSE;
-	game->bigblue.sprite.x = game->width;
-	game->bigblue.sprite.y = game->height / 2;
-	game->bigblue.sprite.frame_delay = 3;
+	ImageCache *cache = &game->images;
+	cache->count = cache->thread_count = 0;
+	SDL_AtomicSet(&cache->next, 0);
+#if defined(PROFILER)
+	SDL_AtomicSet(&cache->workers, 0);
+#endif
+	cache->lock = SDL_CreateMutex();
+	cache->decoded = SDL_CreateCond();
+
+	if (cache->lock == NULL || cache->decoded == NULL) {
+		return; /* Everything loads on the main thread instead. */
+	}
+
+	IMG_Init(IMG_INIT_PNG | IMG_INIT_JPG); /* Before any worker needs the codecs. */
+
+	for (int i = 0; i < SPRITES; i++) {
+		const char *ext = strrchr(sprite_files[i], '.');
+
+		for (int indx = 0; indx < 100 && cache->count < MAX_IMAGES; indx++) { /* Named as in load_image_with_index(). */
+			size_t length = strlen(sprite_files[i]) + 3;
+			char *name = (char *)malloc(length);
+
+			if (name == NULL) {
+				fprintf(stderr, "%s: malloc returned NULL in function %s\n", game->title, __func__);
+				exit(1);
+			}
+
+			snprintf(name, length, "%.*s%02d%s", (int)(ext - sprite_files[i]), sprite_files[i], indx, ext);
+			SDL_RWops *rw = SDL_RWFromFile(name, "rb");
+
+			if (rw == NULL) {
+				free(name);
+				break;
+			}
+
+			SDL_RWclose(rw);
+#if defined(PROFILER)
+			cache->file[cache->count] = sprite_files[i];
+			cache->decode_start[cache->count] = 0;
+#endif
+			cache->name[cache->count] = name;
+			cache->surface[cache->count] = NULL;
+			cache->ready[cache->count++] = SDL_FALSE;
+		}
+	}
+
+	int threads = SDL_min(SDL_max(SDL_GetCPUCount(), 1), DECODE_THREADS);
+
+	while (cache->thread_count < threads) {
+		cache->thread[cache->thread_count] = SDL_CreateThread(decode_images, "decode", cache);
+
+		if (cache->thread[cache->thread_count] == NULL) {
+			break;
+		}
+
+		cache->thread_count++;
+	}
 }
 
-static int initialise_bigblue(Game *game)
+static int decode_images(void *data)
 {
-	int status = initialise_sprite(game, &game->bigblue.sprite, DATADIR"/bigblue.png");
+	ImageCache *cache = (ImageCache *)data;
+	int i;
+#if defined(PROFILER)
+	int worker = SDL_AtomicAdd(&cache->workers, 1);
+#endif
 
-	if (status != 0) {
-		return status;
+	while ((i = SDL_AtomicAdd(&cache->next, 1)) < cache->count) {
+#if defined(PROFILER)
+		cache->worker[i] = worker;
+		cache->decode_start[i] = SDL_GetPerformanceCounter();
+#endif
+		SDL_Surface *surface = IMG_Load(cache->name[i]);
+#if defined(PROFILER)
+		cache->decode_end[i] = SDL_GetPerformanceCounter();
+#endif
+		SDL_LockMutex(cache->lock);
+		cache->surface[i] = surface;
+		cache->ready[i] = SDL_TRUE;
+		SDL_CondBroadcast(cache->decoded);
+		SDL_UnlockMutex(cache->lock);
 	}
 
-	reset_bigblue(game);
 	return 0;
 }
 
-static int initialise_player(Game *game)
+static SDL_bool take_decoded_image(ImageCache *cache, const char *name, SDL_Surface **surface)
 {
-	initialise_craft(&game->player);
-	game->player.key = NO_KEY;
-	int status = initialise_sprite(game, &game->player.sprite, DATADIR"/player.png");
-	game->player.sprite.x = game->width / 2 - game->player.sprite.width / 2;
-	game->player.sprite.y = game->height - game->player.sprite.height - 20;
-	game->player.sprite.is_animated = SDL_TRUE;
-	game->player.sprite.frame_delay = 1;
-	game->player.sprite.is_visible = SDL_TRUE;
-	return status;
-}
+	int i = 0;
 
-static int initialise_alien_type(Game *game, int indx, char *path)
-{
-	int status = initialise_sprite(game, &game->alien_sprite[indx], path);
+	while (i < cache->count && strcmp(cache->name[i], name) != 0) {
+		i++;
+	}
 
-	if (status != 0) {
-		return status;
+	if (i == cache->count || cache->thread_count == 0) {
+		return SDL_FALSE;
 	}
 
-	for (int i = 0; i < game->alien_count; i++) {
-		initialise_craft(&game->alien[indx][i]);
-		copy_sprite(game, &game->alien[indx][i].sprite, &game->alien_sprite[indx]);
-		game->alien[indx][i].sprite.is_animated = SDL_TRUE;
+	SDL_LockMutex(cache->lock);
+
+	while (!cache->ready[i]) {
+		SDL_CondWait(cache->decoded, cache->lock);
 	}
 
-	return 0;
+	*surface = cache->surface[i];
+	cache->surface[i] = NULL; /* The caller owns it now. */
+	SDL_UnlockMutex(cache->lock);
+	return SDL_TRUE;
 }
 
-static void reset_aliens(Game *game)
+static void finish_decoding_images(Game *game)
 {
-	int leader_x = 5;
-	int leader_y = 20;
+	ImageCache *cache = &game->images;
 
-	for (int i = 0; i < game->alien_type; i++) {
-		for (int j = 0; j < game->alien_count; j++) {
-			game->alien[i][j].missile_is_launched = SDL_FALSE;
-			game->alien[i][j].sprite.is_visible = SDL_TRUE;
-			game->alien[i][j].is_exploding = SDL_FALSE;
-			game->alien[i][j].sprite.dx = ((i & 1) << 2) - 2;
-			game->alien[i][j].sprite.dy = 0.1;
-			game->alien[i][j].sprite.x = leader_x + j * (game->alien[i][j].sprite.width + 20.0);
-			game->alien[i][j].sprite.y = leader_y + (i + 1) * (game->alien[i][j].sprite.height + 20.0);
+	for (int i = 0; i < cache->thread_count; i++) {
+		SDL_WaitThread(cache->thread[i], NULL);
+	}
+
+#if defined(PROFILER)
+	for (int i = 0; i < cache->thread_count; i++) {
+		add_trace_event(&game->tracer, "thread_name", "decode", 'M', game->tracer.start, TRACE_DECODE_TID + i);
+	}
+
+	for (int i = 0; i < cache->count; i++) { /* The workers' own spans, now nothing else is writing them. */
+		if (cache->decode_start[i] != 0) {
+			add_trace_event(&game->tracer, "IMG_Load", cache->file[i], 'B', cache->decode_start[i], TRACE_DECODE_TID + cache->worker[i]);
+			add_trace_event(&game->tracer, "IMG_Load", NULL, 'E', cache->decode_end[i], TRACE_DECODE_TID + cache->worker[i]);
 		}
 	}
+#endif
+
+	for (int i = 0; i < cache->count; i++) {
+		SDL_FreeSurface(cache->surface[i]);
+		free(cache->name[i]);
+	}
+
+	cache->count = cache->thread_count = 0;
+	SDL_DestroyCond(cache->decoded);
+	SDL_DestroyMutex(cache->lock);
 }
 
-static int initialise_aliens(Game *game)
+static SDL_Surface *load_image_with_index(Game *game, const char *path, unsigned int indx)
 {
-	int count = 0;
-	int status = initialise_alien_type(game, count++, DATADIR"/purple.png");
+	SDL_Surface *surface = NULL;
+	size_t path_len = strlen(path) + 3;
+	const char *ext = strrchr(path, '.');
+	char *filename = (char *)malloc(path_len * sizeof(char));
 
-	if (status == 0) {
-		status = initialise_alien_type(game, count++, DATADIR"/green.png");
+	if (filename == NULL) {
+		fprintf(stderr, "%s: malloc returned NULL in function %s\n", game->title, __func__);
+		exit(1);
 	}
 
-	if (status == 0) {
-		status = initialise_alien_type(game, count++, DATADIR"/yellow.png");
+	snprintf(filename, path_len, "%.*s%02d%s", (int)(ext - path), path, indx, ext);
+	TRACE_BEGIN(game, "take_decoded_image", path); /* Waiting on a worker, which traces the decode itself. */
+	SDL_bool decoded = take_decoded_image(&game->images, filename, &surface);
+	TRACE_END(game, "take_decoded_image");
+
+	SDL_RWops *rw = decoded ? NULL : SDL_RWFromFile(filename, "rb");
+
+	if (rw != NULL) { /* Past the last frame there is nothing to load or trace. */
+		SDL_RWclose(rw);
+		TRACE_BEGIN(game, "IMG_Load", path);
+		surface = IMG_Load(filename);
+		TRACE_END(game, "IMG_Load");
 	}
 
-	if (status == 0) {
-		status = initialise_alien_type(game, count, DATADIR"/cyan.png");
+	if (surface == NULL && indx == 0) {
+		fprintf(stderr, "%s: In function %s\n", game->title, __func__);
+		fprintf(stderr, "%s: Failed to load %s.\n", game->title, filename);
 	}
 
-	reset_aliens(game);
-	return status;
+	free(filename);
+	return surface;
 }
 
-static int initialise_explosion(Game *game)
+static void set_sprite_width_height(Sprite *sprite, SDL_Surface *surface)
 {
-	int status = initialise_sprite(game, &game->explosion, DATADIR"/explosion.png");
-	game->explosion.is_animated = SDL_TRUE;
-	return status;
+	sprite->width = surface->w;
+	sprite->height = surface->h;
 }
 
-static int initialise_missile(Game *game)
+static void build_sprite_mask(Game *game, Sprite *sprite, SDL_Surface **surfaces, int count)
 {
-	int status = initialise_sprite(game, &game->missile, DATADIR"/missile.png");
-	game->missile.x = game->missile.y = 0;
-	game->missile.frame_delay = 3;
-	game->missile.is_animated = SDL_TRUE;
-	game->missile.is_visible = SDL_TRUE;
+	sprite->mask_words = (sprite->width + 63) / 64;
+	sprite->mask = (Uint64 *)calloc((size_t)count * sprite->height * sprite->mask_words, sizeof(Uint64));
+
+	if (sprite->mask == NULL) {
+		fprintf(stderr, "%s: calloc returned NULL in function %s\n", game->title, __func__);
+		exit(1);
+	}
+
+	for (int i = 0; i < count; i++) {
+		SDL_Surface *surface = SDL_ConvertSurfaceFormat(surfaces[i], SDL_PIXELFORMAT_RGBA32, 0);
+
+		if (surface == NULL) {
+			free(sprite->mask);
+			sprite->mask = NULL; /* Collide on bounding boxes only. */
+			return;
+		}
+
+		int width = SDL_min(surface->w, sprite->width);
+		int height = SDL_min(surface->h, sprite->height);
+		SDL_LockSurface(surface);
+
+		for (int y = 0; y < height; y++) {
+			Uint32 *pixel = (Uint32 *)((Uint8 *)surface->pixels + y * surface->pitch);
+			Uint64 *row = &sprite->mask[(i * sprite->height + y) * sprite->mask_words];
+
+			for (int x = 0; x < width; x++) {
+				Uint8 r, g, b, a;
+				SDL_GetRGBA(pixel[x], surface->format, &r, &g, &b, &a);
+
+				if (a >= MASK_ALPHA) {
+					row[x / 64] |= (Uint64)1 << (x % 64);
+				}
+			}
+		}
+
+		SDL_UnlockSurface(surface);
+		SDL_FreeSurface(surface);
+	}
+}
+
+int load_sprite(Game *game, Sprite *sprite, const char *path)
+{
+	int count = 0;
+	SDL_Surface *surface;
+	SDL_Surface **surfaces = NULL;
+
+	while ((surface = load_image_with_index(game, path, count)) != NULL) {
+		surfaces = realloc(surfaces, sizeof(SDL_Surface *) * (count + 1));
+
+		if (surfaces == NULL) {
+			fprintf(stderr, "%s: realloc returned NULL in function %s\n", game->title, __func__);
+			exit(1);
+		}
+
+		surfaces[count++] = surface;
+	}
+
+	if (count == 0) {
+		return 1;
+	}
+
+	sprite->frame = (SDL_Rect *)malloc(sizeof(SDL_Rect) * count);
+
+	if (sprite->frame == NULL) {
+		fprintf(stderr, "%s: malloc returned NULL in function %s\n", game->title, __func__);
+		exit(1);
+	}
+
+	set_sprite_width_height(sprite, surfaces[0]);
+	sprite->frame_count = count - 1;
+	build_sprite_mask(game, sprite, surfaces, count);
+	int status = add_to_atlas(game, sprite, surfaces, count);
+
+	for (int i = 0; i < count; i++) {
+		SDL_FreeSurface(surfaces[i]);
+	}
+
+	free(surfaces);
+	return status;
+}
+
+static void set_sprite_defaults(Sprite *sprite)
+{
+	sprite->frame = NULL;
+	sprite->mask = NULL;
+	sprite->mask_words = 0;
+	sprite->page = -1;
+	sprite->x = sprite->y = 0.0;
+	sprite->previous_x = sprite->previous_y = 0.0;
+	sprite->width = sprite->height = 0;
+	sprite->current_frame = sprite->frame_delay = sprite->next_frame_time = 0;
+	sprite->dx = sprite->dy = 0.0;
+	sprite->is_visible = SDL_FALSE;
+	sprite->is_animated = SDL_FALSE;
+}
+
+void initialise_batch(SpriteBatch *batch)
+{
+	SDL_Color white = { 255, 255, 255, SDL_ALPHA_OPAQUE };
+	batch->texture = NULL;
+	batch->quad_count = 0;
+
+	for (int i = 0; i < BATCH_QUADS; i++) { /* Two triangles per quad. */
+		int *index = &batch->index[i * 6];
+		index[0] = index[5] = i * 4;
+		index[1] = i * 4 + 1;
+		index[2] = index[3] = i * 4 + 2;
+		index[4] = i * 4 + 3;
+	}
+
+	for (int i = 0; i < BATCH_QUADS * 4; i++) {
+		batch->vertex[i].color = white;
+	}
+}
+
+void flush_batch(Game *game)
+{
+	SpriteBatch *batch = &game->batch;
+
+	if (batch->quad_count == 0) {
+		return;
+	}
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	SDL_RenderGeometry(game->renderer, batch->texture, batch->vertex, batch->quad_count * 4, batch->index, batch->quad_count * 6);
+#endif
+	batch->quad_count = 0;
+}
+
+static void set_vertex(SDL_Vertex *vertex, float x, float y, float u, float v)
+{
+	vertex->position.x = x;
+	vertex->position.y = y;
+	vertex->tex_coord.x = u;
+	vertex->tex_coord.y = v;
+}
+
+void batch_copy(Game *game, SDL_Texture *texture, const SDL_Rect *srect, const SDL_Rect *drect)
+{
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	SpriteBatch *batch = &game->batch;
+
+	if (texture != batch->texture || batch->quad_count == BATCH_QUADS) {
+		flush_batch(game);
+
+		if (texture != batch->texture) {
+			batch->texture = texture;
+			get_texture_dimensions(texture, &batch->texture_width, &batch->texture_height);
+		}
+	}
+
+	SDL_Rect whole = { 0, 0, batch->texture_width, batch->texture_height };
+
+	if (srect == NULL) {
+		srect = &whole;
+	}
+
+	float u0 = (float)srect->x / batch->texture_width;
+	float v0 = (float)srect->y / batch->texture_height;
+	float u1 = (float)(srect->x + srect->w) / batch->texture_width;
+	float v1 = (float)(srect->y + srect->h) / batch->texture_height;
+	float x0 = drect->x;
+	float y0 = drect->y;
+	float x1 = drect->x + drect->w;
+	float y1 = drect->y + drect->h;
+	SDL_Vertex *vertex = &batch->vertex[batch->quad_count++ * 4];
+	set_vertex(&vertex[0], x0, y0, u0, v0);
+	set_vertex(&vertex[1], x1, y0, u1, v0);
+	set_vertex(&vertex[2], x1, y1, u1, v1);
+	set_vertex(&vertex[3], x0, y1, u0, v1);
+#else
+	SDL_RenderCopy(game->renderer, texture, srect, drect);
+#endif
+}
+
+static double interpolate(Game *game, double previous, double current)
+{
+	double distance = current - previous;
+
+	if (distance > INTERPOLATION_LIMIT || distance < -INTERPOLATION_LIMIT) { /* Wrapped or respawned. */
+		return current;
+	}
+
+	return previous + distance * game->alpha;
+}
+
+static void place_sprite(Sprite *sprite, double x, double y)
+{
+	sprite->x = sprite->previous_x = x;
+	sprite->y = sprite->previous_y = y;
+}
+
+static void draw_frame(Game *game, const Sprite *sprite, int frame, double x, double y)
+{
+	SDL_Rect drect = { (int)x, (int)y, sprite->width, sprite->height };
+	batch_copy(game, game->atlas.texture[sprite->page], &sprite->frame[frame], &drect);
+}
+
+static void draw_sprite(Game *game, const Sprite *sprite)
+{
+	if (!sprite->is_visible) {
+		return ;
+	}
+
+	draw_frame(game, sprite, sprite->current_frame, interpolate(game, sprite->previous_x, sprite->x), interpolate(game, sprite->previous_y, sprite->y));
+}
+
+static void animate_sprite(Sprite *sprite)
+{
+	if (!sprite->is_animated) {
+		return;
+	}
+
+	if (sprite->next_frame_time != 0) {
+		sprite->next_frame_time--;
+		return;
+	}
+
+	sprite->next_frame_time = sprite->frame_delay;
+
+	if (sprite->current_frame < sprite->frame_count) {
+		sprite->current_frame++;
+	} else {
+		sprite->current_frame = 0;
+	}
+}
+
+static int initialise_sprite(Game *game, Sprite *sprite, const char *image_path)
+{
+	set_sprite_defaults(sprite);
+	TRACE_BEGIN(game, "load_sprite", image_path);
+	int status = load_sprite(game, sprite, image_path);
+	TRACE_END(game, "load_sprite");
+	return status;
+}
+
+static void draw_background(Game *game)
+{
+	int y = (int)interpolate(game, game->background.previous_y, game->background.y);
+	SDL_Rect *frame = &game->background.frame[0];
+	SDL_Texture *texture = game->atlas.texture[game->background.page];
+	SDL_Rect srect = { frame->x, frame->y, game->width, game->height - y };
+	SDL_Rect drect = { 0, y, game->width, game->height - y };
+	batch_copy(game, texture, &srect, &drect);
+	set_rect(srect, frame->x, frame->y + game->height - y, game->width, y);
+	set_rect(drect, 0, 0, game->width, y);
+	batch_copy(game, texture, &srect, &drect);
+}
+
+static void scroll_background(Game *game)
+{
+	game->background.y++;
+
+	if (game->background.y >= game->height) {
+		game->background.y = 0;
+	}
+}
+
+static int initialise_sdl(Game *game)
+{
+	Uint32 flags = game->headless ? 0 : SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_EVENTS;
+	int status = SDL_Init(flags);
+
+	if (status != 0) {
+		fprintf(stderr, "%s: In function %s ", game->title, __func__);
+		fprintf(stderr, "SDL_Init failed. %s\n", SDL_GetError());
+		return 1;
+	}
+
+	if (game->headless) { /* No font, window or renderer. */
+		game->font = NULL;
+		return 0;
+	}
+
+	status = TTF_Init();
+	
+	if (status != 0) {
+		fprintf(stderr, "%s: In function %s ", game->title, __func__);
+		fprintf(stderr, "TTF_Init failed. %s\n", TTF_GetError());
+		SDL_Quit();
+		return 1;
+	}
+
+	game->font = TTF_OpenFont(DATADIR"/BigBottomCartoon.ttf", 18);
+	
+	if (game->font == NULL) {
+		fprintf(stderr, "%s: In function %s ", game->title, __func__);
+		fprintf(stderr, "Failed to open font. %s\n", TTF_GetError());
+		TTF_Quit();
+		SDL_Quit();
+		return 1;
+	}
+
+	return 0;
+}
+
+static void initialise_craft(Craft *craft)
+{
+	craft->is_exploding = SDL_FALSE;
+	craft->missile_is_launched = SDL_FALSE;
+}
+
+static void reset_player(Game *game)
+{
+	release_projectiles(game, PROJECTILE_PLAYER);
+	game->player.sprite.is_visible = SDL_TRUE;
+}
+
+static void kill_asteroid(Game *game)
+{
+	game->asteroid.sprite.is_visible = SDL_FALSE;
+	game->asteroid.is_exploding = SDL_FALSE;
+	stop_explosions(game, &game->asteroid);
+	release_debris(&game->particles);
+}
+
+static void reset_bigblue(Game *game)
+{
+	initialise_craft(&game->bigblue);
+	stop_explosions(game, &game->bigblue);
+	release_projectiles(game, PROJECTILE_BIGBLUE);
+	game->bigblue.sprite.is_visible = SDL_FALSE;
+	game->bigblue.sprite.x = game->width;
+	game->bigblue.sprite.y = game->height / 2;
+	game->bigblue.sprite.frame_delay = 3;
+}
+
+static int initialise_bigblue(Game *game)
+{
+	int status = initialise_sprite(game, &game->bigblue.sprite, sprite_files[SPRITE_BIGBLUE]);
+
+	if (status != 0) {
+		return status;
+	}
+
+	game->bigblue.hit_time = 0;
+	game->bigblue.sprite.dx = -2;
+	reset_bigblue(game);
+	return 0;
+}
+
+static int initialise_player(Game *game)
+{
+	initialise_craft(&game->player);
+	game->player.key = NO_KEY;
+	game->player.target_x = WIDTH / 2;
+	int status = initialise_sprite(game, &game->player.sprite, sprite_files[SPRITE_PLAYER]);
+	game->player.sprite.x = game->width / 2 - game->player.sprite.width / 2;
+	game->player.sprite.y = game->height - game->player.sprite.height - 20;
+	game->player.sprite.is_animated = SDL_TRUE;
+	game->player.sprite.frame_delay = 1;
+	game->player.sprite.is_visible = SDL_TRUE;
 	return status;
 }
 
-static int initialise_player_missile(Game *game)
-{
-	int status = initialise_sprite(game, &game->player_missile, DATADIR"/playmis.png");
-	game->player_missile.x = game->player_missile.y = 0;
-	game->player_missile.is_visible = SDL_FALSE;
-	game->player_missile.frame_delay = 3;
-	game->player_missile.is_animated = SDL_TRUE;
-	return status;
+static void initialise_alien_store(Game *game)
+{
+	Aliens *aliens = &game->aliens;
+	size_t n = (size_t)ALIEN_TYPE * game->alien_count;
+	size_t slot_size = 6 * sizeof(double) + 5 * sizeof(int) + 2 * sizeof(Uint8);
+	char *pool = (char *)malloc(n * slot_size);
+
+	if (pool == NULL) {
+		fprintf(stderr, "%s: malloc returned NULL in function %s\n", game->title, __func__);
+		exit(1);
+	}
+
+	aliens->pool = pool;
+	aliens->capacity = n;
+	aliens->count = aliens->live_count = 0;
+	aliens->x = (double *)pool;
+	aliens->y = aliens->x + n;
+	aliens->dx = aliens->y + n;
+	aliens->dy = aliens->dx + n;
+	aliens->previous_x = aliens->dy + n;
+	aliens->previous_y = aliens->previous_x + n;
+	aliens->live = (int *)(aliens->previous_y + n);
+	aliens->width = aliens->live + n;
+	aliens->height = aliens->width + n;
+	aliens->current_frame = aliens->height + n;
+	aliens->next_frame_time = aliens->current_frame + n;
+	aliens->flags = (Uint8 *)(aliens->next_frame_time + n);
+	aliens->type = aliens->flags + n;
+	memset(pool, 0, n * slot_size);
+}
+
+static void free_alien_store(Aliens *aliens)
+{
+	free(aliens->pool);
+	aliens->pool = NULL;
+	aliens->capacity = aliens->count = aliens->live_count = 0;
+}
+
+static void initialise_grid(Game *game)
+{
+	Grid *grid = &game->grid;
+	grid->columns = (game->width + GRID_CELL - 1) / GRID_CELL;
+	grid->rows = (game->height + GRID_CELL - 1) / GRID_CELL;
+	grid->cell = (int *)malloc(sizeof(int) * game->aliens.capacity);
+	grid->cell_start = (int *)malloc(sizeof(int) * (grid->columns * grid->rows + 1));
+	grid->entry = (int *)malloc(sizeof(int) * game->aliens.capacity);
+	grid->boxes.left = (double *)malloc(sizeof(double) * 4 * game->aliens.capacity);
+
+	if (grid->cell == NULL || grid->cell_start == NULL || grid->entry == NULL || grid->boxes.left == NULL) {
+		fprintf(stderr, "%s: malloc returned NULL in function %s\n", game->title, __func__);
+		exit(1);
+	}
+
+	grid->boxes.top = grid->boxes.left + game->aliens.capacity;
+	grid->boxes.right = grid->boxes.top + game->aliens.capacity;
+	grid->boxes.bottom = grid->boxes.right + game->aliens.capacity;
+	grid->max_width = grid->max_height = 0;
+	grid->pairs_tested = grid->total_pairs = 0;
+	select_box_kernel(grid);
+}
+
+static void free_grid(Grid *grid)
+{
+	free(grid->cell);
+	free(grid->cell_start);
+	free(grid->entry);
+	free(grid->boxes.left);
+}
+
+static int initialise_alien_type(Game *game, int indx, const char *path)
+{
+	int status = initialise_sprite(game, &game->alien_sprite[indx], path);
+
+	if (status != 0) {
+		return status;
+	}
+
+	for (int i = indx * game->alien_count; i < (indx + 1) * game->alien_count; i++) {
+		game->aliens.current_frame[i] = 0;
+		game->aliens.next_frame_time[i] = 0;
+	}
+
+	return 0;
+}
+
+static void update_live_aliens(Aliens *aliens)
+{
+	aliens->live_count = 0;
+
+	for (int i = 0; i < aliens->count; i++) {
+		if (aliens->flags[i] & ALIEN_VISIBLE) {
+			aliens->live[aliens->live_count++] = i;
+		}
+	}
+}
+
+static void reset_aliens(Game *game)
+{
+	int leader_x = 5;
+	int leader_y = 20;
+	Aliens *aliens = &game->aliens;
+	aliens->count = game->alien_type * game->alien_count;
+	release_projectiles(game, PROJECTILE_ALIEN);
+	stop_explosions(game, NULL);
+
+	for (int i = 0; i < game->alien_type; i++) {
+		int width = game->alien_sprite[i].width;
+		int height = game->alien_sprite[i].height;
+		int columns = SDL_max(1, (game->width - leader_x - width) / (width + 20) + 1);
+		int lines = SDL_max(1, (600 - leader_y) / (height + 20) - 1); /* Rows that fit above the turning point. */
+
+		for (int j = 0; j < game->alien_count; j++) {
+			int k = i * game->alien_count + j;
+			int line = (j / columns) * game->alien_type + i; /* Large waves wrap, interleaving the types. */
+			aliens->type[k] = i;
+			aliens->flags[k] = ALIEN_VISIBLE;
+			aliens->width[k] = width;
+			aliens->height[k] = height;
+			aliens->dx[k] = ((i & 1) << 2) - 2;
+			aliens->dy[k] = 0.1;
+			aliens->x[k] = leader_x + (j % columns) * (width + 20.0);
+			aliens->y[k] = leader_y + (line % lines + 1) * (height + 20.0);
+		}
+	}
+
+	update_live_aliens(aliens);
+}
+
+static int initialise_aliens(Game *game)
+{
+	int status = 0;
+
+	for (int i = 0; i < ALIEN_TYPE && status == 0; i++) {
+		status = initialise_alien_type(game, i, sprite_files[SPRITE_ALIENS + i]);
+	}
+
+	reset_aliens(game);
+	return status;
+}
+
+static int initialise_explosion(Game *game)
+{
+	return initialise_sprite(game, &game->explosion, sprite_files[SPRITE_EXPLOSION]);
+}
+
+static int initialise_missile(Game *game)
+{
+	int status = initialise_sprite(game, &game->missile, sprite_files[SPRITE_MISSILE]);
+	game->missile.x = game->missile.y = 0;
+	game->missile.frame_delay = 3;
+	game->missile.is_animated = SDL_TRUE;
+	game->missile.is_visible = SDL_TRUE;
+	return status;
+}
+
+static int initialise_player_missile(Game *game)
+{
+	int status = initialise_sprite(game, &game->player_missile, sprite_files[SPRITE_PLAYER_MISSILE]);
+	game->player_missile.x = game->player_missile.y = 0;
+	game->player_missile.is_visible = SDL_FALSE;
+	game->player_missile.frame_delay = 3;
+	game->player_missile.is_animated = SDL_TRUE;
+	return status;
+}
+
+static void reset_asteroid(Game *game)
+{
+	int x[2] = { game->width, -game->asteroid.sprite.width };
+	int rand_zero_one = random_bits(game, RANDOM_ASTEROID) & 1;
+	initialise_craft(&game->asteroid);
+	stop_explosions(game, &game->asteroid);
+	game->asteroid.sprite.x = x[rand_zero_one];
+	game->asteroid.sprite.y = LINE_Y + (random_bits(game, RANDOM_ASTEROID) & 128);
+	game->asteroid.sprite.dx = (rand_zero_one << 1) - 1;
+	game->asteroid.sprite.dy = 1;
+	game->asteroid.sprite.is_visible = SDL_TRUE;
+}
+
+static int initialise_line(Game *game)
+{
+	int status = initialise_sprite(game, &game->line, sprite_files[SPRITE_LINE]);
+	place_sprite(&game->line, 50, LINE_Y);
+	game->line.is_visible = SDL_TRUE;
+	return status;
+}
+
+static void reset_asteroid_quarters(Game *game)
+{
+	int x = game->asteroid.sprite.x;
+	int y = game->asteroid.sprite.y;
+	int half_width = game->asteroid.sprite.width / 2;
+	int half_height = game->asteroid.sprite.height / 2;
+	emit_particle(game, 0, x, y, -0.25, -1, -1);
+	emit_particle(game, 1, x + half_width, y, 0.25, -1, -1);
+	emit_particle(game, 2, x, y + half_height, -0.25, 1, -1);
+	emit_particle(game, 3, x + half_width, y + half_height, 0.25, 1, -1);
+}
+
+static int initialise_asteroid_quarters(Game *game)
+{
+	int status = 0;
+
+	for (int i = 0; i < 4 && status == 0; i++) {
+		status = initialise_sprite(game, &game->quarter[i], sprite_files[SPRITE_QUARTERS + i]);
+		game->quarter[i].is_animated = SDL_TRUE;
+	}
+
+	return status;
+}
+
+static int initialise_sprites(Game *game)
+{
+	int status = initialise_bigblue(game);
+
+	if (status == 0) {
+		status = initialise_player(game);
+	}
+
+	if (status == 0) {
+		status = initialise_aliens(game);
+	}
+
+	if (status == 0) {
+		status = initialise_sprite(game, &game->background, sprite_files[SPRITE_BACKGROUND]);
+	}
+
+	if (status == 0) {
+		status = initialise_explosion(game);
+	}
+
+	if (status == 0) {
+		status = initialise_missile(game);
+	}
+
+	if (status == 0) {
+		status = initialise_player_missile(game);
+	}
+
+	if (status == 0) {
+		status = initialise_line(game);
+	}
+
+	if (status == 0) {
+		status = initialise_sprite(game, &game->big_blue_missiles, sprite_files[SPRITE_BIGBLUE_MISSILES]);
+	}
+
+	if (status == 0) {
+		status = initialise_sprite(game, &game->asteroid.sprite, sprite_files[SPRITE_ASTEROID]);
+	}
+
+	if (status == 0) {
+		status = initialise_asteroid_quarters(game);
+	}
+
+	return status;
+}
+
+static void stop_animation(Sprite *sprite)
+{
+	sprite->is_animated = SDL_FALSE;
+	sprite->current_frame = 0;
+	sprite->next_frame_time = 0;
+}
+
+static void explosion_position(Game *game, int i, double *x, double *y)
+{
+	Explosions *explosions = &game->explosions;
+	Craft *craft = explosions->craft[i];
+	int k = explosions->alien[i];
+
+	if (craft != NULL) {
+		*x = craft->sprite.x + craft->sprite.width / 2 - game->explosion.width / 2;
+		*y = craft->sprite.y + craft->sprite.height / 2 - game->explosion.height / 2;
+	} else {
+		*x = game->aliens.x[k] + game->aliens.width[k] / 2 - game->explosion.width / 2;
+		*y = game->aliens.y[k] + game->aliens.height[k] / 2 - game->explosion.height / 2;
+	}
+}
+
+static void start_explosion(Game *game, Craft *craft, int alien)
+{
+	Explosions *explosions = &game->explosions;
+	int i = explosions->count;
+
+	if (i == MAX_EXPLOSIONS) { /* No room to show it, so it is over at once. */
+		finish_explosion(game, craft, alien);
+		return;
+	}
+
+	explosions->count++;
+	explosions->craft[i] = craft;
+	explosions->alien[i] = alien;
+	explosions->frame[i] = 0;
+	explosions->next_frame_time[i] = 0;
+	explosion_position(game, i, &explosions->x[i], &explosions->y[i]);
+	explosions->previous_x[i] = explosions->x[i];
+	explosions->previous_y[i] = explosions->y[i];
+	emit_sparks(game, explosions->x[i] + game->explosion.width / 2, explosions->y[i] + game->explosion.height / 2);
+
+	if (game->audio.playing == SDL_FALSE && game->audio.id != 0) {
+		game->audio.playing = SDL_TRUE;
+		TRACE_BEGIN(game, "SDL_QueueAudio", NULL);
+		SDL_ClearQueuedAudio(game->audio.id);
+		SDL_QueueAudio(game->audio.id, game->audio.audio_info[0].wave_buffer, game->audio.audio_info[0].wave_length);
+		TRACE_END(game, "SDL_QueueAudio");
+	}
+}
+
+static void finish_explosion(Game *game, Craft *craft, int alien)
+{
+	if (craft == NULL) {
+		game->aliens.flags[alien] &= ~(ALIEN_EXPLODING | ALIEN_VISIBLE);
+		return;
+	}
+
+	craft->is_exploding = SDL_FALSE;
+
+	if (craft == &game->player && game->lives > 0) {
+		game->lives--;
+	} else {
+		craft->sprite.is_visible = SDL_FALSE;
+	}
+}
+
+static void remove_explosion(Explosions *explosions, int i)
+{
+	int last = --explosions->count; /* The last explosion fills the gap. */
+	explosions->craft[i] = explosions->craft[last];
+	explosions->alien[i] = explosions->alien[last];
+	explosions->frame[i] = explosions->frame[last];
+	explosions->next_frame_time[i] = explosions->next_frame_time[last];
+	explosions->x[i] = explosions->x[last];
+	explosions->y[i] = explosions->y[last];
+	explosions->previous_x[i] = explosions->previous_x[last];
+	explosions->previous_y[i] = explosions->previous_y[last];
+}
+
+static void stop_explosions(Game *game, Craft *craft)
+{
+	for (int i = game->explosions.count - 1; i >= 0; i--) {
+		if (game->explosions.craft[i] == craft) {
+			remove_explosion(&game->explosions, i);
+		}
+	}
+}
+
+static void explode(Game *game, Craft *craft)
+{
+	if (!craft->is_exploding) {
+		craft->is_exploding = SDL_TRUE;
+		start_explosion(game, craft, -1);
+	}
+}
+
+static void explode_alien(Game *game, int i)
+{
+	if (!(game->aliens.flags[i] & ALIEN_EXPLODING)) {
+		game->aliens.flags[i] |= ALIEN_EXPLODING;
+		start_explosion(game, NULL, i);
+	}
+}
+
+static void update_explosions(Game *game)
+{
+	Explosions *explosions = &game->explosions;
+	int frame_delay = game->explosion.frame_delay;
+	int frame_count = game->explosion.frame_count;
+
+	for (int i = 0; i < explosions->count; i++) {
+		explosion_position(game, i, &explosions->x[i], &explosions->y[i]);
+
+		if (explosions->next_frame_time[i] != 0) {
+			explosions->next_frame_time[i]--;
+			continue;
+		}
+
+		explosions->next_frame_time[i] = frame_delay;
+
+		if (++explosions->frame[i] >= frame_count) {
+			finish_explosion(game, explosions->craft[i], explosions->alien[i]);
+			remove_explosion(explosions, i--);
+		}
+	}
+
+	if (explosions->count == 0) {
+		game->audio.playing = SDL_FALSE;
+	}
+}
+
+static void initialise_particles(Particles *particles)
+{
+	particles->over_budget = SDL_FALSE;
+	particles->update_ticks = particles->max_ticks = particles->total_ticks = 0;
+	particles->updates = 0;
+	clear_particles(particles);
+}
+
+static int emit_particle(Game *game, int kind, double x, double y, double dx, double dy, int life)
+{
+	Particles *particles = &game->particles;
+
+	if (kind < PARTICLE_SPARK ? particles->debris_count == MAX_DEBRIS : particles->count - particles->debris_count == MAX_PARTICLES - MAX_DEBRIS) {
+		return -1;
+	}
+
+	int i = particles->count++;
+	particles->kind[i] = kind;
+	particles->x[i] = particles->previous_x[i] = x;
+	particles->y[i] = particles->previous_y[i] = y;
+	particles->dx[i] = dx;
+	particles->dy[i] = dy;
+	particles->life[i] = life;
+
+	if (kind < PARTICLE_SPARK) {
+		particles->debris_count++;
+	}
+
+	return i;
+}
+
+static void emit_sparks(Game *game, double x, double y)
+{
+	Particles *particles = &game->particles;
+
+	if (particles->over_budget) {
+		return;
+	}
+
+	for (int i = 0; i < PARTICLE_SPARKS; i++) {
+		double dx = random_unit(game, RANDOM_PARTICLES) * 4.0 - 2.0;
+		double dy = random_unit(game, RANDOM_PARTICLES) * 4.0 - 2.0;
+		int life = 10 + (int)(20.0 * random_unit(game, RANDOM_PARTICLES));
+		emit_particle(game, PARTICLE_SPARK, x, y, dx, dy, life);
+	}
+}
+
+static void clear_particles(Particles *particles)
+{
+	particles->count = 0;
+	particles->debris_count = 0;
+}
+
+static void release_debris(Particles *particles)
+{
+	int kept = 0;
+
+	for (int i = 0; i < particles->count; i++) { /* Keep the sparks, in order. */
+		if (particles->kind[i] < PARTICLE_SPARK) {
+			continue;
+		}
+
+		particles->kind[kept] = particles->kind[i];
+		particles->x[kept] = particles->x[i];
+		particles->y[kept] = particles->y[i];
+		particles->dx[kept] = particles->dx[i];
+		particles->dy[kept] = particles->dy[i];
+		particles->previous_x[kept] = particles->previous_x[i];
+		particles->previous_y[kept] = particles->previous_y[i];
+		particles->life[kept] = particles->life[i];
+		kept++;
+	}
+
+	particles->count = kept;
+	particles->debris_count = 0;
+}
+
+static void integrate_particles(Particles *particles)
+{
+	int count = particles->count;
+	int i = 0;
+#if defined(__SSE2__)
+	for (; i + 2 <= count; i += 2) {
+		_mm_storeu_pd(&particles->x[i], _mm_add_pd(_mm_loadu_pd(&particles->x[i]), _mm_loadu_pd(&particles->dx[i])));
+		_mm_storeu_pd(&particles->y[i], _mm_add_pd(_mm_loadu_pd(&particles->y[i]), _mm_loadu_pd(&particles->dy[i])));
+	}
+#endif
+	for (; i < count; i++) {
+		particles->x[i] += particles->dx[i];
+		particles->y[i] += particles->dy[i];
+	}
+
+	for (i = 0; i < count; i++) {
+		particles->life[i] -= particles->life[i] > 0;
+	}
+}
+
+static void cull_particles(Game *game)
+{
+	Particles *particles = &game->particles;
+	int kept = 0;
+	particles->debris_count = 0;
+
+	for (int i = 0; i < particles->count; i++) { /* Compact in place, keeping the order. */
+		int kind = particles->kind[i];
+		int width = kind < PARTICLE_SPARK ? game->quarter[kind].width : 0;
+		int height = kind < PARTICLE_SPARK ? game->quarter[kind].height : 0;
+
+		if (particles->life[i] == 0 || particles->x[i] < -width || particles->x[i] > game->width || particles->y[i] < -height || particles->y[i] > game->height) {
+			continue;
+		}
+
+		particles->kind[kept] = kind;
+		particles->x[kept] = particles->x[i];
+		particles->y[kept] = particles->y[i];
+		particles->dx[kept] = particles->dx[i];
+		particles->dy[kept] = particles->dy[i];
+		particles->previous_x[kept] = particles->previous_x[i];
+		particles->previous_y[kept] = particles->previous_y[i];
+		particles->life[kept] = particles->life[i];
+		particles->debris_count += kind < PARTICLE_SPARK;
+		kept++;
+	}
+
+	particles->count = kept;
+}
+
+static void update_particles(Game *game)
+{
+	Particles *particles = &game->particles;
+	Uint64 start_time = SDL_GetPerformanceCounter();
+	integrate_particles(particles);
+	cull_particles(game);
+	particles->update_ticks = SDL_GetPerformanceCounter() - start_time;
+	particles->total_ticks += particles->update_ticks;
+	particles->max_ticks = SDL_max(particles->max_ticks, particles->update_ticks);
+	particles->updates++;
+	particles->over_budget = particles->update_ticks * 1000000 > PARTICLE_BUDGET_MICROSECONDS * SDL_GetPerformanceFrequency();
+}
+
+static void particle_sprite(Game *game, int i, Sprite *sprite)
+{
+	*sprite = game->quarter[game->particles.kind[i]];
+	sprite->x = game->particles.x[i];
+	sprite->y = game->particles.y[i];
+}
+
+static void initialise_projectiles(Projectiles *projectiles)
+{
+	projectiles->count = 0;
+	projectiles->free_count = MAX_PROJECTILES;
+
+	for (int i = 0; i < MAX_PROJECTILES; i++) {
+		projectiles->free[i] = MAX_PROJECTILES - 1 - i; /* Hand out low slots first. */
+	}
+
+	for (int i = 0; i < PROJECTILE_KINDS; i++) {
+		projectiles->kind_count[i] = 0;
+	}
+}
+
+static int spawn_projectile(Game *game, int kind, double x, double y, double dy, int owner)
+{
+	Projectiles *projectiles = &game->projectiles;
+
+	if (projectiles->free_count == 0) {
+		return -1;
+	}
+
+	int i = projectiles->free[--projectiles->free_count];
+	projectiles->kind[i] = kind;
+	projectiles->owner[i] = owner;
+	projectiles->x[i] = x;
+	projectiles->y[i] = projectiles->previous_y[i] = y;
+	projectiles->dy[i] = dy;
+	projectiles->live_index[i] = projectiles->count;
+	projectiles->live[projectiles->count++] = i;
+	projectiles->kind_count[kind]++;
+	return i;
+}
+
+static void release_projectile(Game *game, int i)
+{
+	Projectiles *projectiles = &game->projectiles;
+	int last = projectiles->live[--projectiles->count];
+
+	if (projectiles->kind[i] == PROJECTILE_ALIEN) {
+		game->aliens.flags[projectiles->owner[i]] &= ~ALIEN_MISSILE;
+	}
+
+	projectiles->live[projectiles->live_index[i]] = last; /* The last live projectile fills the gap. */
+	projectiles->live_index[last] = projectiles->live_index[i];
+	projectiles->kind_count[projectiles->kind[i]]--;
+	projectiles->free[projectiles->free_count++] = i;
+}
+
+static void release_projectiles(Game *game, int kind)
+{
+	Projectiles *projectiles = &game->projectiles;
+
+	for (int i = projectiles->count - 1; i >= 0; i--) {
+		if (projectiles->kind[projectiles->live[i]] == kind) {
+			release_projectile(game, projectiles->live[i]);
+		}
+	}
+}
+
+static Sprite *projectile_template(Game *game, int kind)
+{
+	switch (kind) {
+		case PROJECTILE_PLAYER:
+			return &game->player_missile;
+		case PROJECTILE_ALIEN:
+			return &game->missile;
+		default:
+			return &game->big_blue_missiles;
+	}
+}
+
+static void projectile_sprite(Game *game, int i, Sprite *sprite)
+{
+	*sprite = *projectile_template(game, game->projectiles.kind[i]);
+	sprite->x = game->projectiles.x[i];
+	sprite->y = game->projectiles.y[i];
+}
+
+void launch_missile(Game *game)
+{
+	int launcher_x[4] = { 3, 9, 22, 28 };
+
+	if (game->projectiles.kind_count[PROJECTILE_PLAYER] < game->shot_limit) {
+		spawn_projectile(game, PROJECTILE_PLAYER, game->player.sprite.x + launcher_x[game->player.launcher & 3], game->player.sprite.y, -5, -1);
+		game->player.launcher++;
+	}
+}
+
+static void create_scene_textures(Game *game)
+{
+	if (!SDL_RenderTargetSupported(game->renderer)) {
+		return;
+	}
+
+	game->scene = SDL_CreateTexture(game->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, game->width, game->height);
+	game->pause_screen = SDL_CreateTexture(game->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, game->width, game->height);
+
+	if (game->scene == NULL || game->pause_screen == NULL) { /* Draw straight to the window instead. */
+		fprintf(stderr, "%s: %s\n", game->title, SDL_GetError());
+		SDL_DestroyTexture(game->scene);
+		SDL_DestroyTexture(game->pause_screen);
+		game->scene = game->pause_screen = NULL;
+		return;
+	}
+
+	SDL_SetTextureBlendMode(game->scene, SDL_BLENDMODE_NONE);
+	SDL_SetTextureBlendMode(game->pause_screen, SDL_BLENDMODE_NONE);
+}
+
+static void begin_scene(Game *game)
+{
+	if (game->scene != NULL) {
+		flush_batch(game);
+		SDL_SetRenderTarget(game->renderer, game->scene);
+	}
+}
+
+static void end_scene(Game *game)
+{
+	if (game->scene == NULL) {
+		return;
+	}
+
+	SDL_Rect rect = { 0, 0, game->width, game->height };
+	flush_batch(game);
+	SDL_SetRenderTarget(game->renderer, NULL);
+	batch_copy(game, game->scene, NULL, &rect);
+}
+
+static void create_pause_screen(Game *game)
+{
+	if (!game->paused) {
+		return;
+	}
+
+	flush_batch(game);
+
+	if (game->scene != NULL) { /* Copy the last frame on the GPU. */
+		SDL_Rect rect = { 0, 0, game->width, game->height };
+		SDL_Texture *target = SDL_GetRenderTarget(game->renderer);
+		SDL_SetRenderTarget(game->renderer, game->pause_screen);
+		batch_copy(game, game->scene, NULL, &rect);
+		flush_batch(game);
+		SDL_SetRenderTarget(game->renderer, target);
+		game->has_pause_screen = SDL_TRUE;
+		return;
+	}
+
+	SDL_Surface *capture;
+	Uint32 format = SDL_GetWindowPixelFormat(game->window);
+
+	if (format != SDL_PIXELFORMAT_UNKNOWN) {
+		capture = SDL_CreateRGBSurfaceWithFormat(0, game->width, game->height, SDL_BITSPERPIXEL(format), format);
+	} else {
+		fprintf(stderr, "%s: %s\n", game->title, SDL_GetError());
+		format = SDL_PIXELFORMAT_ARGB8888;
+		capture = SDL_CreateRGBSurface(0, game->width, game->height, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000);
+	}
+
+	if (capture == NULL) {
+		fprintf(stderr, "%s: %s\n", game->title, SDL_GetError());
+		return;
+	}
+
+	if (game->pause_screen != NULL) {
+		SDL_DestroyTexture(game->pause_screen);
+	}
+
+	SDL_RenderReadPixels(game->renderer, NULL, format, capture->pixels, capture->pitch);
+	game->pause_screen = SDL_CreateTextureFromSurface(game->renderer, capture);
+	game->has_pause_screen = game->pause_screen != NULL;
+	SDL_FreeSurface(capture);
+}
+
+static void recapture_pause_screen(Game *game)
+{
+	if (!game->paused) {
+		return; /* Pausing takes a new one. */
+	}
+
+	begin_scene(game); /* Nothing has moved since the snapshot, so the same frame is drawn again. */
+	draw_background(game);
+	render_graphics(game);
+	end_scene(game);
+	create_pause_screen(game);
+}
+
+void restart_after_game_over(Game *game)
+{
+	game->replay.pending |= INPUT_RESTART;
+	reset_game(game);
+	game->paused = SDL_FALSE;
+}
+
+static int handle_key_down(Game *game, SDL_Event *event)
+{
+	if (!game->has_pause_screen && game->paused) {
+		game->paused = SDL_FALSE;
+		return 1;
+	}
+
+	if (game->paused && event->key.keysym.scancode != SDL_SCANCODE_P && event->key.keysym.scancode != SDL_SCANCODE_Q && event->key.keysym.scancode != SDL_SCANCODE_N) {
+		return 1;
+	}
+
+	if (game->replay.mode == REPLAY_PLAY && event->key.keysym.scancode != SDL_SCANCODE_P && event->key.keysym.scancode != SDL_SCANCODE_Q && event->key.keysym.scancode != SDL_SCANCODE_F3) {
+		return 1; /* The replay steers. */
+	}
+
+	switch (event->key.keysym.scancode) {
+		case SDL_SCANCODE_LEFT:
+			game->player.key = LEFT_KEY;
+			break;
+		case SDL_SCANCODE_RIGHT:
+			game->player.key = RIGHT_KEY;
+			break;
+		case SDL_SCANCODE_SPACE:
+		case SDL_SCANCODE_UP:
+			if ((game->replay.pending & INPUT_FIRES) != INPUT_FIRES) { /* Launched at the next tick, as a replay does. */
+				game->replay.pending += INPUT_FIRE;
+			}
+			break;
+		case SDL_SCANCODE_N:
+			restart_after_game_over(game);
+			break;
+		case SDL_SCANCODE_P:
+			if (game->lives != 0) {
+				game->paused ^= SDL_TRUE;
+				TRACE_BEGIN(game, "create_pause_screen", NULL);
+				create_pause_screen(game);
+				TRACE_END(game, "create_pause_screen");
+			}
+			break;
+		case SDL_SCANCODE_Q:
+			return 0;
+#if defined(PROFILER)
+		case SDL_SCANCODE_F3:
+			game->profiler.visible ^= SDL_TRUE;
+			break;
+#endif
+		default:
+			break;
+	}
+
+	return 1;
 }
 
-static void reset_asteroid(Game *game)
+static int handle_key_up(Game *game, SDL_Event *event)
 {
-	int x[2] = { game->width, -game->asteroid.sprite.width };
-	int rand_zero_one = rand() & 1;
-	initialise_craft(&game->asteroid);
-	initialise_craft(&game->debris.upper_left);
-	initialise_craft(&game->debris.upper_right);
-	initialise_craft(&game->debris.lower_left);
-	initialise_craft(&game->debris.lower_right);
-	game->asteroid.sprite.x = x[rand_zero_one];
-	game->asteroid.sprite.y = LINE_Y + (rand() & 128);
-	game->asteroid.sprite.dx = (rand_zero_one << 1) - 1;
-	game->asteroid.sprite.dy = 1;
-	game->asteroid.sprite.is_visible = SDL_TRUE;
+	if (game->replay.mode == REPLAY_PLAY) {
+		return 0;
+	}
+
+	switch (event->key.keysym.scancode) {
+		case SDL_SCANCODE_LEFT:
+			game->player.key &= ~LEFT_KEY;
+			break;
+		case SDL_SCANCODE_RIGHT:
+			game->player.key &= ~RIGHT_KEY;
+			break;
+		default:
+			break;
+	}
+
+	return 0;
 }
 
-static int initialise_line(Game *game)
+static int handle_event(Game *game, SDL_Event *event)
 {
-	int status = initialise_sprite(game, &game->line, DATADIR"/line.png");
-	game->line.x = 50;
-	game->line.y = LINE_Y;
-	game->line.is_visible = SDL_TRUE;
-	return status;
+	switch(event->type) {
+		case SDL_QUIT:
+			return 0;
+		case SDL_KEYDOWN:
+			record_key_press(game, event);
+			return handle_key_down(game, event);
+		case SDL_KEYUP:
+			handle_key_up(game, event);
+			break;
+		case SDL_RENDER_TARGETS_RESET:
+		case SDL_RENDER_DEVICE_RESET:
+			game->hud.is_valid = SDL_FALSE;
+
+			if (game->has_pause_screen) { /* The snapshot went with the targets. */
+				game->has_pause_screen = SDL_FALSE;
+				recapture_pause_screen(game);
+			}
+			break;
+		default:
+			return 1;
+	}
+
+	return 1;
 }
 
-static void reset_asteroid_quarters(Game *game)
+static int handle_events(Game *game)
 {
-	int x = game->asteroid.sprite.x;
-	int y = game->asteroid.sprite.y;
-	initialise_craft(&game->debris.upper_left);
-	initialise_craft(&game->debris.upper_right);
-	initialise_craft(&game->debris.lower_left);
-	initialise_craft(&game->debris.lower_right);
-	game->debris.upper_left.sprite.x = x;
-	game->debris.upper_left.sprite.y = y;
-	game->debris.upper_right.sprite.x = x + game->asteroid.sprite.width / 2;
-	game->debris.upper_right.sprite.y = y;
-	game->debris.lower_left.sprite.x = x;
-	game->debris.lower_left.sprite.y = y + game->asteroid.sprite.height / 2;
-	game->debris.lower_right.sprite.x = x + game->asteroid.sprite.width / 2;
-	game->debris.lower_right.sprite.y = y + game->asteroid.sprite.height / 2;
-	game->debris.upper_left.sprite.dx = -0.25;
-	game->debris.upper_left.sprite.dy = -1;
-	game->debris.upper_right.sprite.dx = 0.25;
-	game->debris.upper_right.sprite.dy = -1;
-	game->debris.lower_left.sprite.dx = -0.25;
-	game->debris.lower_left.sprite.dy = 1;
-	game->debris.lower_right.sprite.dx = 0.25;
-	game->debris.lower_right.sprite.dy = 1;
-	game->debris.upper_left.sprite.is_visible = SDL_TRUE;
-	game->debris.upper_right.sprite.is_visible = SDL_TRUE;
-	game->debris.lower_left.sprite.is_visible = SDL_TRUE;
-	game->debris.lower_right.sprite.is_visible = SDL_TRUE;
-	game->debris.quarters_remaining = 4;
+	SDL_Event event;
+
+	while (SDL_PollEvent(&event) != 0) {
+		if (handle_event(game, &event) == 0) {
+			return 0;
+		}
+
+		if (game->paused) { /* The rest are handled by the pause screen. */
+			break;
+		}
+	}
+
+	return 1;
 }
 
-static int initialise_asteroid_quarters(Game *game)
+int open_replay(Game *game)
 {
-	int status = initialise_sprite(game, &game->debris.upper_left.sprite, DATADIR"/ul.png");
+	Replay *replay = &game->replay;
+	replay->finished = SDL_FALSE;
+	replay->pending = replay->state = 0;
+	replay->run = replay->ticks = 0;
+	replay->recorded_ticks = replay->recorded_score = 0;
 
-	if (status == 0) {
-		status = initialise_sprite(game, &game->debris.upper_right.sprite, DATADIR"/ur.png");
-		game->debris.upper_left.sprite.is_animated = SDL_TRUE;
+	if (replay->mode == REPLAY_OFF) {
+		return 0;
 	}
 
-	if (status == 0) {
-		status = initialise_sprite(game, &game->debris.lower_left.sprite, DATADIR"/ll.png");
-		game->debris.upper_right.sprite.is_animated = SDL_TRUE;
+	replay->file = fopen(replay->path, replay->mode == REPLAY_RECORD ? "wb" : "rb");
+
+	if (replay->file == NULL) {
+		fprintf(stderr, "%s: Could not open %s\n", GAME_TITLE, replay->path);
+		return 1;
 	}
 
-	if (status == 0) {
-		status = initialise_sprite(game, &game->debris.lower_right.sprite, DATADIR"/lr.png");
-		game->debris.lower_left.sprite.is_animated = SDL_TRUE;
+	if (replay->mode == REPLAY_RECORD) { /* Everything else that steers a run is in the header. */
+		fwrite(REPLAY_MAGIC, 1, 4, replay->file);
+		fputc(REPLAY_VERSION, replay->file);
+		write_varint(replay->file, game->seed);
+		write_varint(replay->file, game->alien_count);
+		write_varint(replay->file, game->shot_limit);
+		return 0;
 	}
 
-	game->debris.lower_right.sprite.is_animated = SDL_TRUE;
-	return status;
+	char magic[4];
+
+	if (fread(magic, 1, 4, replay->file) != 4 || memcmp(magic, REPLAY_MAGIC, 4) != 0 || fgetc(replay->file) != REPLAY_VERSION) {
+		fprintf(stderr, "%s: %s is not a replay\n", GAME_TITLE, replay->path);
+		fclose(replay->file);
+		replay->file = NULL;
+		return 1;
+	}
+
+	game->seed = read_varint(replay->file);
+	int alien_count = (int)read_varint(replay->file);
+	int shot_limit = (int)read_varint(replay->file);
+	game->alien_count = SDL_max(alien_count, 1);
+	game->shot_limit = SDL_max(shot_limit, 1);
+	return 0;
 }
 
-static int initialise_sprites(Game *game)
+static void write_varint(FILE *file, Uint64 n)
 {
-	int status = initialise_bigblue(game);
+	while (n >= 0x80) {
+		fputc((int)(n & 0x7f) | 0x80, file);
+		n >>= 7;
+	}
 
-	if (status == 0) {
-		status = initialise_player(game);
+	fputc((int)n, file);
+}
+
+static Uint64 read_varint(FILE *file)
+{
+	Uint64 n = 0;
+	int c;
+
+	for (int shift = 0; shift < 64 && (c = fgetc(file)) != EOF; shift += 7) {
+		n |= (Uint64)(c & 0x7f) << shift;
+
+		if ((c & 0x80) == 0) {
+			break;
+		}
 	}
 
-	if (status == 0) {
-		status = initialise_aliens(game);
+	return n;
+}
+
+static void write_run(Replay *replay)
+{
+	if (replay->run != 0) {
+		fputc(replay->state, replay->file);
+		write_varint(replay->file, replay->run);
 	}
+}
 
-	if (status == 0) {
-		status = initialise_sprite(game, &game->background, DATADIR"/background.jpg");
+static void apply_replay_input(Game *game, Uint8 input)
+{
+	game->player.key = input & (LEFT_KEY | RIGHT_KEY);
+
+	if (input & INPUT_RESTART) {
+		reset_game(game);
 	}
+}
 
-	if (status == 0) {
-		status = initialise_explosion(game);
+static void next_input(Game *game) /* Called at the start of every tick. */
+{
+	Replay *replay = &game->replay;
+	Uint8 input = game->player.key | replay->pending;
+
+	if (replay->mode == REPLAY_RECORD) {
+		if (replay->run == 0 || input != replay->state) {
+			write_run(replay);
+			replay->state = input;
+			replay->run = 0;
+		}
+
+		replay->run++;
+	} else if (replay->mode == REPLAY_PLAY) {
+		if (replay->finished) {
+			return;
+		}
+
+		if (replay->run == 0) {
+			int c = fgetc(replay->file);
+
+			if (c == EOF || c == INPUT_END) {
+				replay->recorded_ticks = c == EOF ? 0 : read_varint(replay->file);
+				replay->recorded_score = c == EOF ? 0 : read_varint(replay->file);
+				replay->finished = SDL_TRUE;
+				return;
+			}
+
+			replay->state = c;
+			replay->run = read_varint(replay->file);
+		}
+
+		replay->run--;
+		input = replay->state;
+		apply_replay_input(game, input);
 	}
 
-	if (status == 0) {
-		status = initialise_missile(game);
+	replay->pending = 0;
+	replay->ticks++;
+
+	for (int i = 0; i < (input & INPUT_FIRES) / INPUT_FIRE; i++) {
+		launch_missile(game);
 	}
+}
 
-	if (status == 0) {
-		status = initialise_player_missile(game);
+void close_replay(Game *game)
+{
+	Replay *replay = &game->replay;
+
+	if (replay->mode == REPLAY_OFF) {
+		return;
 	}
 
-	if (status == 0) {
-		status = initialise_line(game);
+	if (replay->mode == REPLAY_RECORD) {
+		write_run(replay);
+		fputc(INPUT_END, replay->file);
+		write_varint(replay->file, replay->ticks);
+		write_varint(replay->file, game->score.score);
+	} else if (replay->recorded_ticks != 0 && replay->recorded_score != (Uint64)game->score.score) {
+		fprintf(stderr, "%s: Replay diverged, score %d after %llu ticks but %llu was recorded\n", GAME_TITLE, game->score.score, (unsigned long long)replay->ticks, (unsigned long long)replay->recorded_score);
 	}
 
-	if (status == 0) {
-		status = initialise_sprite(game, &game->big_blue_missiles, DATADIR"/missiles.png");
+	fclose(replay->file);
+	replay->file = NULL;
+}
+
+static void discard_replay(Game *game)
+{
+	if (game->replay.file != NULL) { /* The game never started, so there is nothing to end or check. */
+		fclose(game->replay.file);
+		game->replay.file = NULL;
 	}
+}
 
-	if (status == 0) {
-		status = initialise_sprite(game, &game->asteroid.sprite, DATADIR"/asteroid.png");
+static void record_key_press(Game *game, SDL_Event *event)
+{
+	if (!game->latency.enabled || event->key.repeat || game->latency.pending_count == MAX_PENDING_KEYS) {
+		return;
 	}
 
-	if (status == 0) {
-		status = initialise_asteroid_quarters(game);
+	Uint64 queued_ms = SDL_GetTicks() - event->key.timestamp;
+	Uint64 now = SDL_GetPerformanceCounter();
+	game->latency.pending_tick[game->latency.pending_count] = game->latency.ticks;
+	game->latency.pending[game->latency.pending_count++] = now - queued_ms * SDL_GetPerformanceFrequency() / 1000;
+}
+
+static void present_frame(Game *game)
+{
+	flush_batch(game);
+	game->batch.texture = NULL; /* Textures may be recreated between frames. */
+	SDL_RenderPresent(game->renderer);
+
+	if (game->latency.pending_count == 0) {
+		return;
 	}
 
-	return status;
+	Uint64 now = SDL_GetPerformanceCounter();
+	Uint64 frequency = SDL_GetPerformanceFrequency();
+	int kept = 0;
+
+	for (int i = 0; i < game->latency.pending_count; i++) {
+		if (!game->paused && game->latency.pending_tick[i] == game->latency.ticks) { /* No tick has seen this press yet, the pause screen redraws without one. */
+			game->latency.pending_tick[kept] = game->latency.pending_tick[i];
+			game->latency.pending[kept++] = game->latency.pending[i];
+			continue;
+		}
+
+		game->latency.sample[game->latency.sample_count++ % LATENCY_SAMPLES] = (Uint32)((now - game->latency.pending[i]) * 1000000 / frequency);
+	}
+
+	game->latency.pending_count = kept;
 }
 
-static void stop_animation(Sprite *sprite)
+static int compare_samples(const void *a, const void *b)
 {
-	sprite->is_animated = SDL_FALSE;
-	sprite->current_frame = 0;
-	sprite->next_frame_time = 0;
+	Uint32 x = *(const Uint32 *)a;
+	Uint32 y = *(const Uint32 *)b;
+	return (x > y) - (x < y);
 }
 
-static void explode(Game *game, Craft *craft)
+void report_latency(Game *game)
 {
-	game->explosion.is_visible = SDL_TRUE;
-	game->explosion.x = craft->sprite.x + craft->sprite.width / 2 - game->explosion.width / 2;
-	game->explosion.y = craft->sprite.y + craft->sprite.height / 2 - game->explosion.height / 2;
+	Uint32 sorted[LATENCY_SAMPLES];
+	unsigned int count = SDL_min(game->latency.sample_count, LATENCY_SAMPLES);
 
-	if (craft->sprite.is_visible) {
-		draw_sprite(game, &game->explosion);
+	if (!game->latency.enabled || count == 0) {
+		return;
+	}
 
-		if (game->explosion.current_frame == game->explosion.frame_count) {
-			game->explosion.current_frame = 0;
-			craft->is_exploding = SDL_FALSE;
+	memcpy(sorted, game->latency.sample, count * sizeof(Uint32));
+	qsort(sorted, count, sizeof(Uint32), compare_samples);
+	printf("latency samples=%u p50=%.3fms p99=%.3fms max=%.3fms\n", count, sorted[count / 2] / 1000.0, sorted[count * 99 / 100] / 1000.0, sorted[count - 1] / 1000.0);
+}
 
-			if (craft == &game->player && game->lives > 0) {
-				game->lives--;
-			} else {
-				craft->sprite.is_visible = SDL_FALSE;				 
-			}
+#if defined(PROFILER)
+static void initialise_profiler(Profiler *profiler)
+{
+	profiler->frame_count = 0;
 
-			game->audio.playing = SDL_FALSE;
-			return;
-		}
+	for (int i = 0; i < PROFILE_PHASES; i++) {
+		profiler->ticks[i] = 0;
+		profiler->line[i] = NULL;
 	}
+}
 
-	if (game->audio.playing == SDL_FALSE) {
-		game->audio.playing = SDL_TRUE;
-		SDL_ClearQueuedAudio(game->audio.id);
-		SDL_QueueAudio(game->audio.id, game->audio.audio_info[0].wave_buffer, game->audio.audio_info[0].wave_length);
+static void end_profile_frame(Game *game)
+{
+	Profiler *profiler = &game->profiler;
+	Uint64 frequency = SDL_GetPerformanceFrequency();
+	unsigned int slot = profiler->frame_count++ % PROFILE_SAMPLES;
+
+	for (int i = 0; i < PROFILE_PHASES; i++) {
+		profiler->sample[i][slot] = (Uint32)(profiler->ticks[i] * 1000000000 / frequency);
+		profiler->ticks[i] = 0;
 	}
 }
 
-static void launch_missile(Game *game)
+static void profile_stats(Profiler *profiler, int phase, Uint32 *min, double *average, Uint32 *p99)
 {
-	int launcher_x[4] = { 3, 9, 22, 28 };
-	static unsigned int i;
+	Uint32 sorted[PROFILE_SAMPLES];
+	unsigned int count = SDL_min(profiler->frame_count, PROFILE_SAMPLES);
+	double total = 0.0;
 
-	if (!game->player_missile.is_visible) {
-		game->player_missile.is_visible = SDL_TRUE;
-		game->player_missile.x = game->player.sprite.x + launcher_x[i & 3];
-		game->player_missile.y = game->player.sprite.y;
-		i++;
+	if (count == 0) {
+		*min = *p99 = 0;
+		*average = 0.0;
+		return;
+	}
+
+	memcpy(sorted, profiler->sample[phase], count * sizeof(Uint32));
+	qsort(sorted, count, sizeof(Uint32), compare_samples);
+
+	for (unsigned int i = 0; i < count; i++) {
+		total += sorted[i];
 	}
+
+	*min = sorted[0];
+	*average = total / count;
+	*p99 = sorted[count * 99 / 100];
 }
 
-static void create_pause_screen(Game *game)
+static void draw_profiler(Game *game)
 {
-	if (!game->paused) {
+	Profiler *profiler = &game->profiler;
+	const char *name[PROFILE_PHASES] = PROFILE_NAMES;
+
+	if (!profiler->visible) {
 		return;
 	}
 
-	SDL_Surface *capture;
-	Uint32 format = SDL_GetWindowPixelFormat(game->window);
+	if (profiler->line[0] == NULL || profiler->frame_count % PROFILE_REFRESH == 0) {
+		for (int i = 0; i < PROFILE_PHASES; i++) {
+			char text[64];
+			Uint32 min, p99;
+			double average;
+			profile_stats(profiler, i, &min, &average, &p99);
+			snprintf(text, sizeof(text), "%s  %.2f  %.2f  %.2f ms", name[i], min / 1e6, average / 1e6, p99 / 1e6);
+			SDL_DestroyTexture(profiler->line[i]);
+			profiler->line[i] = create_text_texture(game, text);
+		}
+	}
 
-	if (format != SDL_PIXELFORMAT_UNKNOWN) {
-		capture = SDL_CreateRGBSurfaceWithFormat(0, game->width, game->height, SDL_BITSPERPIXEL(format), format);
-	} else {
-		fprintf(stderr, "%s: %s\n", game->title, SDL_GetError());
-		format = SDL_PIXELFORMAT_ARGB8888;
-		capture = SDL_CreateRGBSurface(0, game->width, game->height, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000);
+	int y = 60;
+
+	for (int i = 0; i < PROFILE_PHASES; i++) {
+		SDL_Rect rect = { 10, y, 0, 0 };
+
+		if (profiler->line[i] == NULL) {
+			continue;
+		}
+
+		get_texture_dimensions(profiler->line[i], &rect.w, &rect.h);
+		batch_copy(game, profiler->line[i], NULL, &rect);
+		y += rect.h;
 	}
+}
 
-	if (capture == NULL) {
-		fprintf(stderr, "%s: %s\n", game->title, SDL_GetError());
+void export_profile(Game *game)
+{
+	Profiler *profiler = &game->profiler;
+	const char *name[PROFILE_PHASES] = PROFILE_NAMES;
+
+	if (profiler->path == NULL) {
 		return;
 	}
 
-	if (game->pause_screen != NULL) {
-		SDL_DestroyTexture(game->pause_screen);
+	FILE *file = fopen(profiler->path, "w");
+
+	if (file == NULL) {
+		fprintf(stderr, "%s: Could not open %s\n", game->title, profiler->path);
+		return;
 	}
 
-	SDL_RenderReadPixels(game->renderer, NULL, format, capture->pixels, capture->pitch);
-	game->pause_screen = SDL_CreateTextureFromSurface(game->renderer, capture);
-	SDL_FreeSurface(capture);
+	size_t length = strlen(profiler->path);
+	SDL_bool json = length >= 5 && strcmp(profiler->path + length - 5, ".json") == 0;
+	unsigned int count = SDL_min(profiler->frame_count, PROFILE_SAMPLES);
+
+	if (json) {
+		fprintf(file, "{\"frames\": %u, \"samples\": %u, \"phases\": [", profiler->frame_count, count);
+	} else {
+		fprintf(file, "phase,min_ms,avg_ms,p99_ms\n");
+	}
+
+	for (int i = 0; i < PROFILE_PHASES; i++) {
+		Uint32 min, p99;
+		double average;
+		profile_stats(profiler, i, &min, &average, &p99);
+
+		if (json) {
+			fprintf(file, "%s\n\t{\"phase\": \"%s\", \"min_ms\": %.4f, \"avg_ms\": %.4f, \"p99_ms\": %.4f}", i == 0 ? "" : ",", name[i], min / 1e6, average / 1e6, p99 / 1e6);
+		} else {
+			fprintf(file, "%s,%.4f,%.4f,%.4f\n", name[i], min / 1e6, average / 1e6, p99 / 1e6);
+		}
+	}
+
+	if (json) {
+		fprintf(file, "\n]}\n");
+	}
+
+	fclose(file);
+}
+
+static void free_profiler(Profiler *profiler)
+{
+	for (int i = 0; i < PROFILE_PHASES; i++) {
+		SDL_DestroyTexture(profiler->line[i]);
+		profiler->line[i] = NULL;
+	}
+}
+
+static void begin_phase(Game *game, int phase)
+{
+	const char *name[PROFILE_PHASES] = PROFILE_NAMES;
+	game->profiler.start[phase] = SDL_GetPerformanceCounter();
+	trace_event(game, name[phase], NULL, 'B');
+}
+
+static void end_phase(Game *game, int phase)
+{
+	const char *name[PROFILE_PHASES] = PROFILE_NAMES;
+	game->profiler.ticks[phase] += SDL_GetPerformanceCounter() - game->profiler.start[phase];
+	trace_event(game, name[phase], NULL, 'E');
+}
+
+int open_trace(Game *game)
+{
+	Tracer *tracer = &game->tracer;
+	tracer->start = SDL_GetPerformanceCounter();
+
+	if (tracer->path == NULL) {
+		return 0;
+	}
+
+	tracer->file = fopen(tracer->path, "w");
+
+	if (tracer->file == NULL) {
+		fprintf(stderr, "%s: Could not open %s\n", GAME_TITLE, tracer->path);
+		return 1;
+	}
+
+	tracer->event[0] = (TraceEvent *)malloc(sizeof(TraceEvent) * TRACE_EVENTS * 2);
+
+	if (tracer->event[0] == NULL) {
+		fprintf(stderr, "%s: malloc returned NULL in function %s\n", GAME_TITLE, __func__);
+		exit(1);
+	}
+
+	tracer->event[1] = tracer->event[0] + TRACE_EVENTS;
+	tracer->count[0] = tracer->count[1] = 0;
+	tracer->current = 0;
+	tracer->quit = SDL_FALSE;
+	tracer->full = SDL_CreateSemaphore(0);
+	tracer->empty = SDL_CreateSemaphore(1);
+	fprintf(tracer->file, "{\"traceEvents\": [\n");
+	fprintf(tracer->file, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"game\"}}");
+	tracer->thread = tracer->full == NULL || tracer->empty == NULL ? NULL : SDL_CreateThread(write_trace, "trace", tracer);
+
+	if (tracer->thread == NULL) { /* close_trace() only cleans up after a running writer. */
+		fprintf(stderr, "%s: %s\n", GAME_TITLE, SDL_GetError());
+		SDL_DestroySemaphore(tracer->full);
+		SDL_DestroySemaphore(tracer->empty);
+		free(tracer->event[0]);
+		fclose(tracer->file);
+		tracer->file = NULL;
+		return 1;
+	}
+
+	return 0;
+}
+
+static void trace_event(Game *game, const char *name, const char *detail, char phase)
+{
+	add_trace_event(&game->tracer, name, detail, phase, SDL_GetPerformanceCounter(), 1);
+}
+
+static void add_trace_event(Tracer *tracer, const char *name, const char *detail, char phase, Uint64 time, int tid)
+{
+	if (tracer->file == NULL) {
+		return;
+	}
+
+	TraceEvent *event = &tracer->event[tracer->current][tracer->count[tracer->current]++];
+	event->name = name;
+	event->detail = detail;
+	event->time = time;
+	event->tid = tid;
+	event->phase = phase;
+
+	if (tracer->count[tracer->current] == TRACE_EVENTS) {
+		hand_off_trace(tracer);
+	}
 }
 
-static void restart_after_game_over(Game *game)
-{
-	reset_game(game);
-	game->paused = SDL_FALSE;
+static void write_json_string(FILE *file, const char *string)
+{
+	fputc('"', file);
+
+	for (; *string != '\0'; string++) {
+		if (*string == '"' || *string == '\\') {
+			fputc('\\', file);
+		}
+
+		fputc(*string, file);
+	}
+
+	fputc('"', file);
 }
 
-static int handle_key_down(Game *game, SDL_Event *event)
+static int write_trace(void *data)
 {
-	if (game->pause_screen == NULL && game->paused) {
-		game->paused = SDL_FALSE;
-		return 1;
-	}
+	Tracer *tracer = (Tracer *)data;
+	double frequency = (double)SDL_GetPerformanceFrequency();
 
-	if (game->paused && event->key.keysym.scancode != SDL_SCANCODE_P && event->key.keysym.scancode != SDL_SCANCODE_Q && event->key.keysym.scancode != SDL_SCANCODE_N) {
-		return 1;
-	}
+	while (1) {
+		SDL_SemWait(tracer->full);
 
-	switch (event->key.keysym.scancode) {
-		case SDL_SCANCODE_LEFT:
-			game->player.key = LEFT_KEY;
-			break;
-		case SDL_SCANCODE_RIGHT:
-			game->player.key = RIGHT_KEY;
-			break;
-		case SDL_SCANCODE_SPACE:
-		case SDL_SCANCODE_UP:
-			launch_missile(game);
+		if (tracer->quit) {
 			break;
-		case SDL_SCANCODE_N:
-			restart_after_game_over(game);
-			break;
-		case SDL_SCANCODE_P:
-			if (game->lives != 0) {
-				game->paused ^= SDL_TRUE;
-				create_pause_screen(game);
+		}
+
+		TraceEvent *event = tracer->event[tracer->writing];
+
+		for (int i = 0; i < tracer->count[tracer->writing]; i++) {
+			fprintf(tracer->file, ",\n{\"name\": ");
+			write_json_string(tracer->file, event[i].name);
+			fprintf(tracer->file, ", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": 1, \"tid\": %d", event[i].phase, (event[i].time - tracer->start) * 1e6 / frequency, event[i].tid);
+
+			if (event[i].detail != NULL) {
+				fprintf(tracer->file, event[i].phase == 'M' ? ", \"args\": {\"name\": " : ", \"args\": {\"detail\": ");
+				write_json_string(tracer->file, event[i].detail);
+				fputc('}', tracer->file);
 			}
-			break;
-		case SDL_SCANCODE_Q:
-			return 0;
-		default:
-			break;
-	}
 
-	return 1;
-}
+			fputc('}', tracer->file);
+		}
 
-static int handle_key_up(Game *game, SDL_Event *event)
-{
-	switch (event->key.keysym.scancode) {
-		case SDL_SCANCODE_LEFT:
-			game->player.key &= ~LEFT_KEY;
-			break;
-		case SDL_SCANCODE_RIGHT:
-			game->player.key &= ~RIGHT_KEY;
-			break;
-		default:
-			break;
+		tracer->count[tracer->writing] = 0;
+		SDL_SemPost(tracer->empty);
 	}
 
 	return 0;
 }
 
-static int handle_event(Game *game, SDL_Event *event)
+static void hand_off_trace(Tracer *tracer)
 {
-	switch(event->type) {
-		case SDL_QUIT:
-			return 0;
-		case SDL_KEYDOWN:
-			return handle_key_down(game, event);
-		case SDL_KEYUP:
-			handle_key_up(game, event);
-			break;
-		default:
-			return 1;
+	SDL_SemWait(tracer->empty); /* Only blocks if the writer is a whole buffer behind. */
+	tracer->writing = tracer->current;
+	tracer->current ^= 1;
+	tracer->count[tracer->current] = 0;
+	SDL_SemPost(tracer->full);
+}
+
+void close_trace(Game *game)
+{
+	Tracer *tracer = &game->tracer;
+
+	if (tracer->file == NULL) {
+		return;
 	}
 
-	return 1;
+	hand_off_trace(tracer);
+	SDL_SemWait(tracer->empty);
+	tracer->quit = SDL_TRUE;
+	SDL_SemPost(tracer->full);
+	SDL_WaitThread(tracer->thread, NULL);
+	fprintf(tracer->file, "\n]}\n");
+	fclose(tracer->file);
+	tracer->file = NULL;
+	SDL_DestroySemaphore(tracer->full);
+	SDL_DestroySemaphore(tracer->empty);
+	free(tracer->event[0]);
 }
+#endif
 
 static void get_texture_dimensions(SDL_Texture *texture, int *width, int *height)
 {
@@ -852,19 +2489,16 @@ static int create_text_textures(Game *game)
 
 static void draw_lives(Game *game)
 {
-	int sx = game->player.sprite.x;
-	int sy = game->player.sprite.y;
-	game->player.sprite.x = game->width / 2 - ((game->player.sprite.width + 2) * game->lives) / 2;
-	game->player.sprite.y = 10;
-	int inc = game->player.sprite.width + 2;
+	Sprite life = game->player.sprite;
+	int x = game->width / 2 - ((life.width + 2) * game->lives) / 2;
+	life.is_visible = SDL_TRUE;
+	life.current_frame = 0; /* Still, so the HUD can be cached. */
 
 	for (int i = 0; i < game->lives; i++) {
-		draw_sprite(game, &game->player.sprite);
-		game->player.sprite.x += inc;
+		place_sprite(&life, x, 10);
+		draw_sprite(game, &life);
+		x += life.width + 2;
 	}
-
-	game->player.sprite.x = sx;
-	game->player.sprite.y = sy;
 }
 
 static void draw_score_digits(Game *game)
@@ -874,7 +2508,7 @@ static void draw_score_digits(Game *game)
 
 	for (int i = 0; i < 7; i++) {
 		set_rect(drect, 5 + span, 1, game->score.char_width[game->score.score_digit[i]], game->score.char_height[game->score.score_digit[i]]);
-		SDL_RenderCopy(game->renderer, game->score.digit_texture[game->score.score_digit[i]], NULL, &drect);
+		batch_copy(game, game->score.digit_texture[game->score.score_digit[i]], NULL, &drect);
 		span += game->score.char_width[game->score.score_digit[i]];
 	}
 }
@@ -886,12 +2520,12 @@ static void draw_high_score_digits(Game *game)
 
 	for (int i = 0; i < 7; i++) {
 		set_rect(drect, WIDTH - 120 + span, 1, game->score.char_width[game->score.high_digit[i]], game->score.char_height[game->score.high_digit[i]]);
-		SDL_RenderCopy(game->renderer, game->score.digit_texture[game->score.high_digit[i]], NULL, &drect);
+		batch_copy(game, game->score.digit_texture[game->score.high_digit[i]], NULL, &drect);
 		span += game->score.char_width[game->score.high_digit[i]];
 	}
 }
 
-static void draw_scores(Game *game)
+static void update_scores(Game *game)
 {
 	int i = 6;
 
@@ -926,39 +2560,126 @@ static void draw_scores(Game *game)
 		game->score.visible_high++;
 	}
 
+	if (game->score.score > game->score.high) {
+		game->score.high = game->score.score;
+	}
+}
+
+static void draw_scores(Game *game)
+{
 	draw_score_digits(game);
 	draw_high_score_digits(game);
+}
 
-	if (game->score.score > game->score.high) {
-		game->score.high = game->score.score;
+static void create_hud_texture(Game *game)
+{
+	game->hud.is_valid = SDL_FALSE;
+	game->hud.texture = NULL;
+
+	if (!SDL_RenderTargetSupported(game->renderer)) {
+		return;
+	}
+
+	game->hud.texture = SDL_CreateTexture(game->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, game->width, LINE_Y);
+
+	if (game->hud.texture == NULL) {
+		fprintf(stderr, "%s: %s\n", game->title, SDL_GetError());
+		return;
 	}
+
+	SDL_SetTextureBlendMode(game->hud.texture, SDL_BLENDMODE_BLEND);
 }
 
-static void draw_aliens(Game *game)
+static SDL_bool hud_is_stale(Game *game)
 {
-	for (int i = 0; i < game->alien_type; i++) {
-		for (int j = 0; j < game->alien_count; j++) {
-			draw_sprite(game, &game->alien[i][j].sprite);
+	return !game->hud.is_valid || game->hud.score != game->score.visible_score || game->hud.high != game->score.visible_high || game->hud.lives != game->lives;
+}
 
-			if (game->alien[i][j].is_exploding) {
-				explode(game, &game->alien[i][j]);
-			}
+static void render_hud(Game *game)
+{
+	SDL_Texture *target = SDL_GetRenderTarget(game->renderer);
+	flush_batch(game);
+	SDL_SetRenderTarget(game->renderer, game->hud.texture);
+	SDL_SetRenderDrawColor(game->renderer, 0, 0, 0, SDL_ALPHA_TRANSPARENT);
+	SDL_RenderClear(game->renderer);
+	draw_lives(game);
+	draw_scores(game);
+	flush_batch(game);
+	SDL_SetRenderTarget(game->renderer, target);
+	SDL_SetRenderDrawColor(game->renderer, 255, 255, 0, SDL_ALPHA_OPAQUE);
+	game->hud.score = game->score.visible_score;
+	game->hud.high = game->score.visible_high;
+	game->hud.lives = game->lives;
+	game->hud.is_valid = SDL_TRUE;
+}
 
-			if (game->alien[i][j].missile_is_launched) {
-				game->missile.x = game->alien[i][j].missile_x;
-				game->missile.y = game->alien[i][j].missile_y;
-				draw_sprite(game, &game->missile);
-			}
+static void draw_hud(Game *game)
+{
+	if (game->hud.texture == NULL) {
+		draw_lives(game);
+		draw_scores(game);
+		return;
+	}
+
+	if (hud_is_stale(game)) {
+		render_hud(game);
+	}
+
+	SDL_Rect rect = { 0, 0, game->width, LINE_Y };
+	batch_copy(game, game->hud.texture, NULL, &rect);
+}
+
+static void draw_explosions(Game *game)
+{
+	Explosions *explosions = &game->explosions;
+
+	for (int i = 0; i < explosions->count; i++) {
+		draw_frame(game, &game->explosion, explosions->frame[i], interpolate(game, explosions->previous_x[i], explosions->x[i]), interpolate(game, explosions->previous_y[i], explosions->y[i]));
+	}
+}
+
+static void draw_aliens(Game *game)
+{
+	Aliens *aliens = &game->aliens;
+
+	for (int i = 0; i < aliens->count; i++) {
+		if (aliens->flags[i] & ALIEN_VISIBLE) {
+			double x = interpolate(game, aliens->previous_x[i], aliens->x[i]);
+			double y = interpolate(game, aliens->previous_y[i], aliens->y[i]);
+			draw_frame(game, &game->alien_sprite[aliens->type[i]], aliens->current_frame[i], x, y);
 		}
 	}
 }
 
-static void draw_asteroid_quarters(Game *game)
+static void draw_projectiles(Game *game)
+{
+	Projectiles *projectiles = &game->projectiles;
+
+	for (int i = 0; i < projectiles->count; i++) {
+		int k = projectiles->live[i];
+		Sprite *sprite = projectile_template(game, projectiles->kind[k]);
+		draw_frame(game, sprite, sprite->current_frame, projectiles->x[k], interpolate(game, projectiles->previous_y[k], projectiles->y[k]));
+	}
+}
+
+static void draw_particles(Game *game)
 {
-	draw_sprite(game, &game->debris.upper_left.sprite);
-	draw_sprite(game, &game->debris.upper_right.sprite);
-	draw_sprite(game, &game->debris.lower_left.sprite);
-	draw_sprite(game, &game->debris.lower_right.sprite);
+	Particles *particles = &game->particles;
+	Sprite *explosion = &game->explosion;
+
+	for (int i = 0; i < particles->count; i++) {
+		double x = interpolate(game, particles->previous_x[i], particles->x[i]);
+		double y = interpolate(game, particles->previous_y[i], particles->y[i]);
+		int kind = particles->kind[i];
+
+		if (kind < PARTICLE_SPARK) {
+			draw_frame(game, &game->quarter[kind], game->quarter[kind].current_frame, x, y);
+		} else { /* A shrinking copy of the explosion's brightest frame. */
+			int size = 1 + particles->life[i] / 5;
+			SDL_Rect drect = { (int)x - size / 2, (int)y - size / 2, size, size };
+			batch_copy(game, game->atlas.texture[explosion->page], &explosion->frame[explosion->frame_count / 2], &drect);
+		}
+	}
 }
 
 static int render_graphics(Game *game)
@@ -966,73 +2687,127 @@ static int render_graphics(Game *game)
 	draw_aliens(game);
 	draw_sprite(game, &game->bigblue.sprite);
 	draw_sprite(game, &game->asteroid.sprite);
-	draw_asteroid_quarters(game);
+	draw_particles(game);
+	draw_sprite(game, &game->player.sprite);
+	draw_explosions(game);
 
-	if (game->bigblue.is_exploding) {
-		explode(game, &game->bigblue);
+	draw_projectiles(game);
+	draw_hud(game);
+	draw_sprite(game, &game->line);
+	return 0;
+}
+
+static void animate_visible_sprite(Sprite *sprite)
+{
+	if (sprite->is_visible) {
+		animate_sprite(sprite);
 	}
+}
+
+static void animate_alien(Game *game, int i)
+{
+	Aliens *aliens = &game->aliens;
+	Sprite *sprite = &game->alien_sprite[aliens->type[i]];
 
-	if (game->asteroid.is_exploding) {
-		explode(game, &game->asteroid);
+	if (aliens->next_frame_time[i] != 0) {
+		aliens->next_frame_time[i]--;
+		return;
 	}
 
-	draw_sprite(game, &game->player.sprite);
+	aliens->next_frame_time[i] = sprite->frame_delay;
 
-	if (game->player.is_exploding) {
-		explode(game, &game->player);
+	if (aliens->current_frame[i] < sprite->frame_count) {
+		aliens->current_frame[i]++;
+	} else {
+		aliens->current_frame[i] = 0;
 	}
+}
 
-	draw_sprite(game, &game->player_missile);
-	draw_sprite(game, &game->big_blue_missiles);
-	draw_lives(game);
-	draw_scores(game);
-	draw_sprite(game, &game->line);
-	return 0;
+static void update_animations(Game *game)
+{
+	Aliens *aliens = &game->aliens;
+
+	for (int i = 0; i < aliens->live_count; i++) {
+		int k = aliens->live[i];
+
+		if (!(aliens->flags[k] & ALIEN_VISIBLE)) {
+			continue;
+		}
+
+		animate_alien(game, k);
+	}
+
+	update_explosions(game);
+
+	animate_visible_sprite(&game->missile);
+	animate_visible_sprite(&game->bigblue.sprite);
+	animate_visible_sprite(&game->asteroid.sprite);
+
+	if (game->particles.debris_count != 0) {
+		for (int i = 0; i < 4; i++) {
+			animate_sprite(&game->quarter[i]);
+		}
+	}
+
+	animate_visible_sprite(&game->player.sprite);
+
+	if (game->projectiles.kind_count[PROJECTILE_PLAYER] != 0) {
+		animate_sprite(&game->player_missile);
+	}
+
+	if (game->projectiles.kind_count[PROJECTILE_BIGBLUE] != 0) {
+		animate_sprite(&game->big_blue_missiles);
+	}
 }
 
 static void move_big_blue_missiles(Game *game)
 {
-	if (game->big_blue_missiles.is_visible) {
-		game->big_blue_missiles.y += 2;
+	Projectiles *projectiles = &game->projectiles;
 
-		if (game->big_blue_missiles.y > game->height) {
-			game->big_blue_missiles.y = 0;
-			game->big_blue_missiles.is_visible = SDL_FALSE;
-			return;
-		}
+	if (projectiles->kind_count[PROJECTILE_BIGBLUE] != 0) {
+		for (int i = 0; i < projectiles->count; i++) {
+			int k = projectiles->live[i];
+			Sprite missile;
+
+			if (projectiles->kind[k] != PROJECTILE_BIGBLUE) {
+				continue;
+			}
+
+			projectiles->y[k] += projectiles->dy[k];
+			projectile_sprite(game, k, &missile);
 
-		if (has_intersection(&game->big_blue_missiles, &game->player.sprite)) {
-			game->big_blue_missiles.y = 0;
-			game->big_blue_missiles.is_visible = SDL_FALSE;
-			game->player.is_exploding = SDL_TRUE;
+			if (projectiles->y[k] > game->height) {
+				release_projectile(game, k);
+				i--; /* The last projectile moved into this place. */
+			} else if (sprites_collide(&missile, &game->player.sprite)) {
+				release_projectile(game, k);
+				i--;
+				explode(game, &game->player);
+			}
 		}
 
 		return;
 	}
 
-	if ((rand() & 1023) < game->level && game->bigblue.sprite.is_visible) {
-		game->big_blue_missiles.x = game->bigblue.sprite.x;
-		game->big_blue_missiles.y = game->bigblue.sprite.y + 101;
-		game->big_blue_missiles.is_visible = SDL_TRUE;
+	if ((random_bits(game, RANDOM_BIGBLUE) & 1023) < (Uint32)game->level && game->bigblue.sprite.is_visible) {
+		spawn_projectile(game, PROJECTILE_BIGBLUE, game->bigblue.sprite.x, game->bigblue.sprite.y + 101, 2, -1);
 	}
 }
 
 static void move_bigblue(Game *game)
 {
-	static int hit_time, dx = -2;
-
 	if (game->bigblue.sprite.is_animated) {
-		hit_time++;
+		game->bigblue.hit_time++;
 
-		if (hit_time == 500) {
+		if (game->bigblue.hit_time == 500) {
 			stop_animation(&game->bigblue.sprite);
-			hit_time = 0;
+			game->bigblue.hit_time = 0;
 		}
 	} else {
-		hit_time = 0;
+		game->bigblue.hit_time = 0;
 	}
 
-	game->bigblue.sprite.x += dx;
+	game->bigblue.sprite.x += game->bigblue.sprite.dx;
 
 	if (game->bigblue.sprite.x < -game->bigblue.sprite.width) {
 		game->bigblue.sprite.x = game->width;
@@ -1054,136 +2829,381 @@ static void level_up(Game *game)
 	reset_aliens(game);
 }
 
-static void move_alien_missile(Game *game, Craft *alien)
+static void move_alien_missiles(Game *game)
 {
-	if (!alien->missile_is_launched) {
-		return;
+	Projectiles *projectiles = &game->projectiles;
+
+	for (int i = 0; i < projectiles->count; i++) {
+		int k = projectiles->live[i];
+
+		if (projectiles->kind[k] != PROJECTILE_ALIEN) {
+			continue;
+		}
+
+		projectiles->y[k] += projectiles->dy[k];
+
+		if (projectiles->y[k] > game->height || check_if_alien_missile_hit_player(game, k)) {
+			release_projectile(game, k);
+			i--; /* The last projectile moved into this place. */
+		}
 	}
+}
+
+static int grid_cell(int n, int limit)
+{
+	n = n < 0 ? 0 : n / GRID_CELL;
+	return n < limit ? n : limit - 1;
+}
+
+static Uint64 intersect_boxes_scalar(const Boxes *boxes, int first, int count, const double *box)
+{
+	Uint64 mask = 0;
 
-	alien->missile_y += 2;
-	game->missile.x = alien->missile_x;
-	game->missile.y = alien->missile_y;
+	for (int i = 0; i < count; i++) {
+		int e = first + i;
 
-	if (alien->missile_y > game->height) {
-		alien->missile_is_launched = SDL_FALSE;
+		if (box[0] <= boxes->right[e] && box[2] >= boxes->left[e] && box[1] <= boxes->bottom[e] && box[3] >= boxes->top[e]) {
+			mask |= (Uint64)1 << i;
+		}
 	}
+
+	return mask;
 }
 
-static void check_if_player_missile_hit_alien(Game *game, Craft *alien)
+#if defined(__SSE2__)
+static Uint64 intersect_boxes_sse2(const Boxes *boxes, int first, int count, const double *box)
 {
-	if (!game->player_missile.is_visible || !alien->sprite.is_visible) {
-		return;
+	__m128d left = _mm_set1_pd(box[0]);
+	__m128d top = _mm_set1_pd(box[1]);
+	__m128d right = _mm_set1_pd(box[2]);
+	__m128d bottom = _mm_set1_pd(box[3]);
+	Uint64 mask = 0;
+	int i = 0;
+
+	for (; i + 2 <= count; i += 2) {
+		int e = first + i;
+		__m128d hit = _mm_and_pd(_mm_cmple_pd(left, _mm_loadu_pd(&boxes->right[e])), _mm_cmpge_pd(right, _mm_loadu_pd(&boxes->left[e])));
+		hit = _mm_and_pd(hit, _mm_cmple_pd(top, _mm_loadu_pd(&boxes->bottom[e])));
+		hit = _mm_and_pd(hit, _mm_cmpge_pd(bottom, _mm_loadu_pd(&boxes->top[e])));
+		mask |= (Uint64)_mm_movemask_pd(hit) << i;
+	}
+
+	if (i < count) { /* Shifting by 64 is undefined. */
+		mask |= intersect_boxes_scalar(boxes, first + i, count - i, box) << i;
+	}
+
+	return mask;
+}
+#endif
+
+#if defined(HAVE_AVX2_KERNEL)
+__attribute__((target("avx2")))
+static Uint64 intersect_boxes_avx2(const Boxes *boxes, int first, int count, const double *box)
+{
+	__m256d left = _mm256_set1_pd(box[0]);
+	__m256d top = _mm256_set1_pd(box[1]);
+	__m256d right = _mm256_set1_pd(box[2]);
+	__m256d bottom = _mm256_set1_pd(box[3]);
+	Uint64 mask = 0;
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		int e = first + i;
+		__m256d hit = _mm256_and_pd(_mm256_cmp_pd(left, _mm256_loadu_pd(&boxes->right[e]), _CMP_LE_OQ), _mm256_cmp_pd(right, _mm256_loadu_pd(&boxes->left[e]), _CMP_GE_OQ));
+		hit = _mm256_and_pd(hit, _mm256_cmp_pd(top, _mm256_loadu_pd(&boxes->bottom[e]), _CMP_LE_OQ));
+		hit = _mm256_and_pd(hit, _mm256_cmp_pd(bottom, _mm256_loadu_pd(&boxes->top[e]), _CMP_GE_OQ));
+		mask |= (Uint64)_mm256_movemask_pd(hit) << i;
+	}
+
+	if (i < count) { /* Shifting by 64 is undefined. */
+		mask |= intersect_boxes_scalar(boxes, first + i, count - i, box) << i;
+	}
+
+	return mask;
+}
+#endif
+
+void select_box_kernel(Grid *grid)
+{
+	grid->intersect = intersect_boxes_scalar;
+	grid->kernel_name = "scalar";
+#if defined(__SSE2__)
+	if (SDL_HasSSE2()) {
+		grid->intersect = intersect_boxes_sse2;
+		grid->kernel_name = "sse2";
+	}
+#endif
+#if defined(HAVE_AVX2_KERNEL)
+	if (SDL_HasAVX2()) {
+		grid->intersect = intersect_boxes_avx2;
+		grid->kernel_name = "avx2";
+	}
+#endif
+}
+
+static void set_query_box(double *box, Sprite *sprite)
+{
+	box[0] = sprite->x;
+	box[1] = sprite->y;
+	box[2] = sprite->x + sprite->width;
+	box[3] = sprite->y + sprite->height;
+}
+
+static void build_grid(Game *game)
+{
+	Aliens *aliens = &game->aliens;
+	Grid *grid = &game->grid;
+	int cells = grid->columns * grid->rows;
+	grid->max_width = grid->max_height = 0;
+
+	for (int c = 0; c <= cells; c++) {
+		grid->cell_start[c] = 0;
+	}
+
+	for (int i = 0; i < aliens->live_count; i++) { /* Count the aliens in each cell by top left corner. */
+		int k = aliens->live[i];
+		grid->cell[k] = grid_cell((int)aliens->y[k], grid->rows) * grid->columns + grid_cell((int)aliens->x[k], grid->columns);
+		grid->cell_start[grid->cell[k] + 1]++;
+		grid->max_width = SDL_max(grid->max_width, aliens->width[k]);
+		grid->max_height = SDL_max(grid->max_height, aliens->height[k]);
+	}
+
+	for (int c = 0; c < cells; c++) {
+		grid->cell_start[c + 1] += grid->cell_start[c];
+	}
+
+	for (int i = 0; i < aliens->live_count; i++) { /* Stable, so each cell stays in slot order. */
+		int k = aliens->live[i];
+		int e = grid->cell_start[grid->cell[k]]++;
+		grid->entry[e] = k;
+		grid->boxes.left[e] = aliens->x[k];
+		grid->boxes.top[e] = aliens->y[k];
+		grid->boxes.right[e] = aliens->x[k] + aliens->width[k];
+		grid->boxes.bottom[e] = aliens->y[k] + aliens->height[k];
+	}
+
+	for (int c = cells; c > 0; c--) {
+		grid->cell_start[c] = grid->cell_start[c - 1];
+	}
+
+	grid->cell_start[0] = 0;
+}
+
+static void grid_range(Game *game, Sprite *sprite, SDL_Rect *range)
+{
+	Grid *grid = &game->grid;
+	range->x = grid_cell((int)(sprite->x - grid->max_width), grid->columns);
+	range->y = grid_cell((int)(sprite->y - grid->max_height), grid->rows);
+	range->w = grid_cell((int)(sprite->x + sprite->width), grid->columns) - range->x + 1;
+	range->h = grid_cell((int)(sprite->y + sprite->height), grid->rows) - range->y + 1;
+}
+
+static SDL_bool alien_pixels_overlap(Game *game, int i, Sprite *sprite)
+{
+	Aliens *aliens = &game->aliens;
+	return pixels_overlap(&game->alien_sprite[aliens->type[i]], aliens->current_frame[i], aliens->x[i], aliens->y[i], sprite, sprite->current_frame, sprite->x, sprite->y);
+}
+
+static SDL_bool check_if_shot_hit_aliens(Game *game, int shot)
+{
+	Grid *grid = &game->grid;
+	Sprite missile;
+	SDL_Rect range;
+	double box[4];
+	int hit = -1;
+	projectile_sprite(game, shot, &missile);
+	grid_range(game, &missile, &range);
+	set_query_box(box, &missile);
+
+	for (int row = range.y; row < range.y + range.h; row++) { /* The cells of a row are contiguous. */
+		int first = grid->cell_start[row * grid->columns + range.x];
+		int last = grid->cell_start[row * grid->columns + range.x + range.w];
+
+		for (int e = first; e < last; e += 64) {
+			int count = SDL_min(64, last - e);
+			Uint64 mask = grid->intersect(&grid->boxes, e, count, box);
+			grid->pairs_tested += count;
+
+			for (int i = 0; mask != 0; i++, mask >>= 1) {
+				if ((mask & 1) && (hit < 0 || grid->entry[e + i] < hit) && alien_pixels_overlap(game, grid->entry[e + i], &missile)) {
+					hit = grid->entry[e + i]; /* The missile stops at the first alien in slot order. */
+				}
+			}
+		}
+	}
+
+	if (hit < 0) {
+		return SDL_FALSE;
+	}
+
+	explode_alien(game, hit);
+	game->score.score += 20;
+	return SDL_TRUE;
+}
+
+static void check_if_shots_hit_aliens(Game *game)
+{
+	Projectiles *projectiles = &game->projectiles;
+
+	for (int i = 0; i < projectiles->count; i++) {
+		int k = projectiles->live[i];
+
+		if (projectiles->kind[k] == PROJECTILE_PLAYER && check_if_shot_hit_aliens(game, k)) {
+			release_projectile(game, k);
+			i--; /* The last projectile moved into this place. */
+		}
 	}
+}
+
+static void check_if_quarter_hit_aliens(Game *game, Sprite *quarter)
+{
+	Grid *grid = &game->grid;
+	SDL_Rect range;
+	double box[4];
+	grid_range(game, quarter, &range);
+	set_query_box(box, quarter);
+
+	for (int row = range.y; row < range.y + range.h; row++) {
+		int first = grid->cell_start[row * grid->columns + range.x];
+		int last = grid->cell_start[row * grid->columns + range.x + range.w];
+
+		for (int e = first; e < last; e += 64) {
+			int count = SDL_min(64, last - e);
+			Uint64 mask = grid->intersect(&grid->boxes, e, count, box);
+			grid->pairs_tested += count;
 
-	if (has_intersection(&alien->sprite, &game->player_missile)) {
-		alien->is_exploding = SDL_TRUE;
-		game->player_missile.is_visible = SDL_FALSE;
-		game->score.score += 20;
+			for (int i = 0; mask != 0; i++, mask >>= 1) {
+				int k = grid->entry[e + i];
+
+				if ((mask & 1) && !(game->aliens.flags[k] & ALIEN_EXPLODING) && alien_pixels_overlap(game, k, quarter)) {
+					explode_alien(game, k);
+					game->score.score += 20;
+				}
+			}
+		}
 	}
 }
 
-static void check_if_quarter_hit_alien(Game *game, Craft *quarter, Craft *alien)
+static void check_if_quarters_hit_aliens(Game *game)
 {
-	if (!quarter->sprite.is_visible || alien->is_exploding) {
-		return;
-	}
-
-	if (has_intersection(&alien->sprite, &quarter->sprite)) {
-		alien->is_exploding = SDL_TRUE;
-		game->score.score += 20;
+	for (int i = 0; i < game->particles.count; i++) {
+		if (game->particles.kind[i] < PARTICLE_SPARK) {
+			Sprite quarter;
+			particle_sprite(game, i, &quarter);
+			check_if_quarter_hit_aliens(game, &quarter);
+		}
 	}
 }
 
-static void check_if_quarters_hit_alien(Game *game, Craft *alien)
+static void check_if_shots_hit_asteroid(Game *game)
 {
-	if (!alien->sprite.is_visible) {
+	Projectiles *projectiles = &game->projectiles;
+
+	if (!game->asteroid.sprite.is_visible) {
 		return;
 	}
 
-	check_if_quarter_hit_alien(game, &game->debris.upper_left, alien);
-	check_if_quarter_hit_alien(game, &game->debris.upper_right, alien);
-	check_if_quarter_hit_alien(game, &game->debris.lower_left, alien);
-	check_if_quarter_hit_alien(game, &game->debris.lower_right, alien);
-}
+	for (int i = 0; i < projectiles->count; i++) {
+		int k = projectiles->live[i];
+		Sprite missile;
 
-static void check_if_player_missile_hit_asteroid(Game *game)
-{
-	if (!game->player_missile.is_visible || !game->asteroid.sprite.is_visible) {
-		return;
-	}
+		if (projectiles->kind[k] != PROJECTILE_PLAYER) {
+			continue;
+		}
+
+		projectile_sprite(game, k, &missile);
 
-	if (has_intersection(&game->asteroid.sprite, &game->player_missile)) {
-		game->player_missile.is_visible = SDL_FALSE;
-		game->score.score += 20;
-		reset_asteroid_quarters(game);
-		game->asteroid.is_exploding = SDL_TRUE;
+		if (sprites_collide(&game->asteroid.sprite, &missile)) {
+			release_projectile(game, k);
+			game->score.score += 20;
+			reset_asteroid_quarters(game);
+			explode(game, &game->asteroid);
+			return;
+		}
 	}
 }
 
-static void check_if_alien_missile_hit_player(Game *game, Craft *alien)
+static SDL_bool check_if_alien_missile_hit_player(Game *game, int i)
 {
-	if (!alien->missile_is_launched) {
-		return;
-	}
+	Sprite missile;
+	projectile_sprite(game, i, &missile);
+	game->grid.pairs_tested++;
 
-	if (has_intersection(&game->missile, &game->player.sprite)) {
-		alien->missile_is_launched = SDL_FALSE;
-		game->player.is_exploding = SDL_TRUE;
+	if (!sprites_collide(&missile, &game->player.sprite)) {
+		return SDL_FALSE;
 	}
+
+	explode(game, &game->player);
+	return SDL_TRUE;
 }
 
-static void move_alien_ship(Game *game, Craft *alien)
+static void move_alien_ship(Game *game, int i)
 {
-	alien->sprite.x += alien->sprite.dx;
-	alien->sprite.y += alien->sprite.dy;
+	Aliens *aliens = &game->aliens;
+	aliens->x[i] += aliens->dx[i];
+	aliens->y[i] += aliens->dy[i];
 
-	if (alien->sprite.x > game->width - alien->sprite.width || alien->sprite.x < 0) {
-		alien->sprite.dx = -alien->sprite.dx;
+	if (aliens->x[i] > game->width - aliens->width[i] || aliens->x[i] < 0) {
+		aliens->dx[i] = -aliens->dx[i];
 	}
 
 	if (game->level <= ALIEN_TYPE) {
 		return;
 	}
 
-	if ((rand() & 8191) > 8189) {
-		alien->sprite.dy = 1.0;
+	if ((random_bits(game, RANDOM_ALIENS) & 8191) > 8189) {
+		aliens->dy[i] = 1.0;
 	}
 
-	if (alien->sprite.y > 600 || alien->sprite.y < 72) {
-		alien->sprite.dy = -alien->sprite.dy;
+	if (aliens->y[i] > 600 || aliens->y[i] < 72) {
+		aliens->dy[i] = -aliens->dy[i];
 	}
 }
 
-static void fire_alien_ship_missile(Game *game, Craft *alien)
+static void fire_alien_ship_missile(Game *game, int i)
 {
-	if ((rand() & 1023) >= game->level || alien->missile_is_launched) {
+	Aliens *aliens = &game->aliens;
+
+	if ((random_bits(game, RANDOM_ALIENS) & 1023) >= (Uint32)game->level || (aliens->flags[i] & ALIEN_MISSILE)) {
 		return;
 	}
 
-	alien->missile_is_launched = SDL_TRUE;
-	alien->missile_x = alien->sprite.x + alien->sprite.width / 2;
-	alien->missile_y = alien->sprite.y + alien->sprite.height;
+	if (spawn_projectile(game, PROJECTILE_ALIEN, (int)(aliens->x[i] + aliens->width[i] / 2), (int)(aliens->y[i] + aliens->height[i]), 2, i) >= 0) {
+		aliens->flags[i] |= ALIEN_MISSILE;
+	}
 }
 
-static void move_aliens(Game *game)
+void move_aliens(Game *game)
 {
+	Aliens *aliens = &game->aliens;
 	int aliens_alive = 0;
+	game->grid.pairs_tested = 0;
 
-	for (int i = 0; i < game->alien_type; i++) {
-		for (int j = 0; j < game->alien_count; j++) {
-			move_alien_missile(game, &game->alien[i][j]);
-			check_if_alien_missile_hit_player(game, &game->alien[i][j]);
-
-			if (game->alien[i][j].sprite.is_visible) {
-				aliens_alive++;
-				check_if_player_missile_hit_alien(game, &game->alien[i][j]);
-				check_if_quarters_hit_alien(game, &game->alien[i][j]);
-				move_alien_ship(game, &game->alien[i][j]);
-				fire_alien_ship_missile(game, &game->alien[i][j]);
-			}
+	move_alien_missiles(game); /* Missiles outlive the aliens that fired them. */
+
+	for (int i = 0; i < aliens->live_count; i++) {
+		int k = aliens->live[i];
+
+		if (aliens->flags[k] & ALIEN_VISIBLE) { /* Drop aliens that finished exploding. */
+			aliens->live[aliens_alive++] = k;
 		}
 	}
 
+	aliens->live_count = aliens_alive;
+
+	if (game->projectiles.kind_count[PROJECTILE_PLAYER] != 0 || game->particles.debris_count != 0) { /* Nothing to query otherwise. */
+		build_grid(game);
+		check_if_shots_hit_aliens(game);
+		check_if_quarters_hit_aliens(game);
+	}
+
+	for (int i = 0; i < aliens->live_count; i++) {
+		move_alien_ship(game, aliens->live[i]);
+		fire_alien_ship_missile(game, aliens->live[i]);
+	}
+
+	game->grid.total_pairs += game->grid.pairs_tested;
+
 	if (aliens_alive == 0) {
 		level_up(game);
 	}
@@ -1191,7 +3211,7 @@ static void move_aliens(Game *game)
 
 static void move_player(Game *game)
 {
-	static int x = WIDTH / 2;
+	int x = game->player.target_x;
 
 	if (game->player.key == LEFT_KEY && x >= game->player.sprite.x) {
 		x -= 2;
@@ -1199,6 +3219,8 @@ static void move_player(Game *game)
 		x += 2;
 	}
 
+	game->player.target_x = x;
+
 	if (game->player.sprite.x > x) {
 		if (game->player.sprite.x > 0) {
 			game->player.sprite.x--;
@@ -1210,32 +3232,35 @@ static void move_player(Game *game)
 	}
 }
 
-static void check_if_player_missile_hit_bigblue(Game *game)
+static SDL_bool check_if_shot_hit_bigblue(Game *game, int shot)
 {
-	if (!game->bigblue.sprite.is_visible || !has_intersection(&game->bigblue.sprite, &game->player_missile)) {
-		return;
-	}
+	Sprite missile;
+	projectile_sprite(game, shot, &missile);
 
-	game->player_missile.is_visible = SDL_FALSE;
+	if (!game->bigblue.sprite.is_visible || !sprites_collide(&game->bigblue.sprite, &missile)) {
+		return SDL_FALSE;
+	}
 
 	if (game->bigblue.sprite.is_animated) {
 		stop_animation(&game->bigblue.sprite);
-		game->bigblue.is_exploding = SDL_TRUE;
+		explode(game, &game->bigblue);
 		game->score.score += 100;
 	} else {
 		game->bigblue.sprite.is_animated = SDL_TRUE;
 	}
+
+	return SDL_TRUE;
 }
 
-static void check_if_quarter_hit_bigblue(Game *game, Craft *quarter)
+static void check_if_quarter_hit_bigblue(Game *game, Sprite *quarter)
 {
-	if (!has_intersection(&game->bigblue.sprite, &quarter->sprite)) {
+	if (!sprites_collide(&game->bigblue.sprite, quarter)) {
 		return;
 	}
 
 	if (game->bigblue.sprite.is_animated) {
 		stop_animation(&game->bigblue.sprite);
-		game->bigblue.is_exploding = SDL_TRUE;
+		explode(game, &game->bigblue);
 		game->score.score += 100;
 	} else {
 		game->bigblue.sprite.is_animated = SDL_TRUE;
@@ -1248,25 +3273,33 @@ static void check_if_quarters_hit_bigblue(Game *game)
 		return;
 	}
 
-	check_if_quarter_hit_bigblue(game, &game->debris.upper_left);
-	check_if_quarter_hit_bigblue(game, &game->debris.upper_right);
-	check_if_quarter_hit_bigblue(game, &game->debris.lower_left);
-	check_if_quarter_hit_bigblue(game, &game->debris.lower_right);
+	for (int i = 0; i < game->particles.count; i++) {
+		if (game->particles.kind[i] < PARTICLE_SPARK) {
+			Sprite quarter;
+			particle_sprite(game, i, &quarter);
+			check_if_quarter_hit_bigblue(game, &quarter);
+		}
+	}
 }
 
-static void move_player_missile(Game *game)
+static void move_player_shots(Game *game)
 {
-	if (!game->player_missile.is_visible) {
-		return;
-	}
+	Projectiles *projectiles = &game->projectiles;
 
-	game->player_missile.y -= 5;
+	for (int i = 0; i < projectiles->count; i++) {
+		int k = projectiles->live[i];
 
-	if (game->player_missile.y < LINE_Y) {
-		game->player_missile.is_visible = SDL_FALSE;
-	}
+		if (projectiles->kind[k] != PROJECTILE_PLAYER) {
+			continue;
+		}
+
+		projectiles->y[k] += projectiles->dy[k];
 
-	check_if_player_missile_hit_bigblue(game);
+		if (projectiles->y[k] < LINE_Y || check_if_shot_hit_bigblue(game, k)) {
+			release_projectile(game, k);
+			i--; /* The last projectile moved into this place. */
+		}
+	}
 }
 
 static void move_asteroid(Game *game)
@@ -1277,71 +3310,27 @@ static void move_asteroid(Game *game)
 
 	game->asteroid.sprite.x += game->asteroid.sprite.dx;
 	game->asteroid.sprite.y += game->asteroid.sprite.dy;
-	check_if_player_missile_hit_asteroid(game);
+	check_if_shots_hit_asteroid(game);
 
 	if (game->asteroid.sprite.x > game->width || game->asteroid.sprite.y > game->height || game->asteroid.sprite.x < -game->asteroid.sprite.width) {
 		game->asteroid.sprite.is_visible = SDL_FALSE;
 	}
 }
 
-static void move_asteroid_quarters(Game *game)
-{
-	if (game->debris.quarters_remaining == 0) {
-		return;
-	}
-
-	if (game->debris.upper_left.sprite.is_visible) {
-		game->debris.upper_left.sprite.x += game->debris.upper_left.sprite.dx;
-		game->debris.upper_left.sprite.y += game->debris.upper_left.sprite.dy;
-
-		if (game->debris.upper_left.sprite.x < -game->debris.upper_left.sprite.width || game->debris.upper_left.sprite.y < -game->debris.upper_left.sprite.height) {
-			game->debris.quarters_remaining--;
-			game->debris.upper_left.sprite.is_visible = SDL_FALSE;
-		}
-	}
-
-	if (game->debris.upper_right.sprite.is_visible) {
-		game->debris.upper_right.sprite.x += game->debris.upper_right.sprite.dx;
-		game->debris.upper_right.sprite.y += game->debris.upper_right.sprite.dy;
-
-		if (game->debris.upper_right.sprite.x > game->width || game->debris.upper_right.sprite.y < -game->debris.upper_right.sprite.height) {
-			game->debris.quarters_remaining--;
-			game->debris.upper_right.sprite.is_visible = SDL_FALSE;
-		}
-	}
-
-	if (game->debris.lower_left.sprite.is_visible) {
-		game->debris.lower_left.sprite.x += game->debris.lower_left.sprite.dx;
-		game->debris.lower_left.sprite.y += game->debris.lower_left.sprite.dy;
-
-		if (game->debris.lower_left.sprite.x < -game->debris.lower_left.sprite.width || game->debris.lower_left.sprite.y > game->height) {
-			game->debris.quarters_remaining--;
-			game->debris.lower_left.sprite.is_visible = SDL_FALSE;
-		}
-	}
-
-	if (game->debris.lower_right.sprite.is_visible) {
-		game->debris.lower_right.sprite.x += game->debris.lower_right.sprite.dx;
-		game->debris.lower_right.sprite.y += game->debris.lower_right.sprite.dy;
-
-		if (game->debris.lower_right.sprite.x > game->width || game->debris.lower_right.sprite.y > game->height) {
-			game->debris.quarters_remaining--;
-			game->debris.lower_right.sprite.is_visible = SDL_FALSE;
-		}
-	}
-
-	check_if_quarters_hit_bigblue(game);
-}
-
 static void move_graphics(Game *game)
 {
 	move_bigblue(game);
 	move_big_blue_missiles(game);
 	move_aliens(game);
 	move_player(game);
-	move_player_missile(game);
+	move_player_shots(game);
 	move_asteroid(game);
-	move_asteroid_quarters(game);
+	PROFILE_END(game, PROFILE_MOVE); /* Particles are a phase of their own. */
+	PROFILE_BEGIN(game, PROFILE_PARTICLES);
+	update_particles(game);
+	PROFILE_END(game, PROFILE_PARTICLES);
+	PROFILE_BEGIN(game, PROFILE_MOVE);
+	check_if_quarters_hit_bigblue(game);
 }
 
 static void show_game_over_message(Game *game)
@@ -1354,7 +3343,7 @@ static void show_game_over_message(Game *game)
 
 	SDL_Rect rect;
 	set_rect(rect, game->width / 2 - width / 2, game->height / 2 - height / 2 - 40, width, height);
-	SDL_RenderCopy(game->renderer, game->game_over_message, NULL, &rect);
+	batch_copy(game, game->game_over_message, NULL, &rect);
 }
 
 static void bring_on_big_blue_at_random(Game *game)
@@ -1363,7 +3352,7 @@ static void bring_on_big_blue_at_random(Game *game)
 		return;
 	}
 
-	if ((rand() & 8191) > 8189) {
+	if ((random_bits(game, RANDOM_BIGBLUE) & 8191) > 8189) {
 		reset_bigblue(game);
 		game->bigblue.sprite.is_visible = SDL_TRUE;
 	}
@@ -1375,11 +3364,11 @@ static void bring_on_asteroid_at_random(Game *game)
 		return;
 	}
 
-	if (game->debris.quarters_remaining != 0) {
+	if (game->particles.debris_count != 0) {
 		return;
 	}
 
-	if ((rand() & 8191) > 8182) {
+	if ((random_bits(game, RANDOM_ASTEROID) & 8191) > 8182) {
 		reset_asteroid(game);
 	}
 }
@@ -1390,6 +3379,54 @@ static void bring_on_others_at_random(Game *game)
 	bring_on_asteroid_at_random(game);
 }
 
+static void save_position(Sprite *sprite)
+{
+	sprite->previous_x = sprite->x;
+	sprite->previous_y = sprite->y;
+}
+
+static void save_positions(Game *game)
+{
+	Aliens *aliens = &game->aliens;
+	memcpy(aliens->previous_x, aliens->x, aliens->count * sizeof(double));
+	memcpy(aliens->previous_y, aliens->y, aliens->count * sizeof(double));
+	memcpy(game->explosions.previous_x, game->explosions.x, game->explosions.count * sizeof(double));
+	memcpy(game->explosions.previous_y, game->explosions.y, game->explosions.count * sizeof(double));
+
+	for (int i = 0; i < game->projectiles.count; i++) {
+		int k = game->projectiles.live[i];
+		game->projectiles.previous_y[k] = game->projectiles.y[k];
+	}
+
+	save_position(&game->background);
+	save_position(&game->bigblue.sprite);
+	save_position(&game->asteroid.sprite);
+	memcpy(game->particles.previous_x, game->particles.x, game->particles.count * sizeof(double));
+	memcpy(game->particles.previous_y, game->particles.y, game->particles.count * sizeof(double));
+	save_position(&game->player.sprite);
+}
+
+void update_game(Game *game)
+{
+	next_input(game);
+
+	if (game->replay.finished) {
+		return;
+	}
+
+	game->latency.ticks++;
+	save_positions(game);
+	scroll_background(game);
+	update_animations(game);
+	update_scores(game);
+	PROFILE_BEGIN(game, PROFILE_SPAWN);
+	bring_on_others_at_random(game);
+	PROFILE_END(game, PROFILE_SPAWN);
+	PROFILE_BEGIN(game, PROFILE_MOVE);
+	move_graphics(game);
+	PROFILE_END(game, PROFILE_MOVE);
+}
+
 static void show_paused_message(Game *game)
 {
 	int hp = 0;
@@ -1404,100 +3441,329 @@ static void show_paused_message(Game *game)
 
 	for (int i = 0; i < PAUSE_MSG; i++) {
 		set_rect(rect, game->width / 2 - width[i] / 2, game->height / 2 - height[i] / 2 + hp, width[i], height[i]);
-		SDL_RenderCopy(game->renderer, game->paused_message[i], NULL, &rect);
+		batch_copy(game, game->paused_message[i], NULL, &rect);
 		hp += height[i] + 10;
 	}
 
-	double x = game->player_missile.x;
-	double y = game->player_missile.y;
-	game->player_missile.x = game->width / 2 - width[0] / 2 - 24;
-	game->player_missile.y = game->height / 2 - height[0] / 2 + 10;
-	SDL_bool is_visible = game->player_missile.is_visible;
-	game->player_missile.is_visible = SDL_TRUE;
-	draw_sprite(game, &game->player_missile);
-	game->player_missile.is_visible = is_visible;
-	game->player_missile.x = x;
-	game->player_missile.y = y;
-	x = game->player.sprite.x;
-	y = game->player.sprite.y;
-	game->player.sprite.x = game->width / 2 - width[1] / 2 - 40;
-	game->player.sprite.y = game->height / 2 - height[1] / 2 + height[0] + 10;
-	draw_sprite(game, &game->player.sprite);
-	game->player.sprite.x = x;
-	game->player.sprite.y = y;
+	place_sprite(&game->cursor[0], game->width / 2 - width[0] / 2 - 24, game->height / 2 - height[0] / 2 + 10);
+	game->cursor[0].is_visible = SDL_TRUE;
+	draw_sprite(game, &game->cursor[0]);
+	place_sprite(&game->cursor[1], game->width / 2 - width[1] / 2 - 40, game->height / 2 - height[1] / 2 + height[0] + 10);
+	draw_sprite(game, &game->cursor[1]);
+}
+
+static void initialise_pacer(FramePacer *pacer, int fps)
+{
+	Uint64 frequency = SDL_GetPerformanceFrequency();
+	pacer->period = fps > 0 ? frequency / fps : 0;
+	pacer->spin = frequency * PACER_SPIN_MICROSECONDS / 1000000;
+	pacer->deadline = SDL_GetPerformanceCounter() + pacer->period;
+}
+
+static void wait_for_next_frame(FramePacer *pacer)
+{
+	if (pacer->period == 0) {
+		return;
+	}
+
+	Uint64 now = SDL_GetPerformanceCounter();
+
+	if (now >= pacer->deadline) { /* Late. Drop the missed frames rather than rushing to catch up. */
+		pacer->deadline += pacer->period;
+
+		if (now >= pacer->deadline) {
+			pacer->deadline = now + pacer->period;
+		}
+
+		return;
+	}
+
+	Uint64 remaining = pacer->deadline - now;
+
+	if (remaining > pacer->spin) {
+		Uint64 ns = (remaining - pacer->spin) * 1000000000 / SDL_GetPerformanceFrequency();
+		struct timespec ts = { ns / 1000000000, ns % 1000000000 };
+		nanosleep(&ts, NULL);
+	}
+
+	while (SDL_GetPerformanceCounter() < pacer->deadline) {
+	}
+
+	pacer->deadline += pacer->period; /* Absolute schedule, so sleep overshoot does not accumulate. */
+}
+
+static void draw_pause_screen(Game *game)
+{
+	SDL_Rect srect = { 0, 0, game->width, game->height };
+	SDL_Rect drect = { 0, 0, game->width, game->height };
+
+	if (game->has_pause_screen) {
+		batch_copy(game, game->pause_screen, &srect, &drect);
+	} else {
+		batch_copy(game, game->atlas.texture[game->background.page], &game->background.frame[0], &drect);
+	}
+
+	if (game->lives == 0) {
+		show_game_over_message(game);
+	}
+
+	show_paused_message(game);
+}
+
+static SDL_bool event_needs_redraw(SDL_Event *event)
+{
+	switch (event->type) {
+		case SDL_KEYDOWN:
+			return SDL_TRUE;
+		case SDL_WINDOWEVENT:
+			return event->window.event == SDL_WINDOWEVENT_EXPOSED || event->window.event == SDL_WINDOWEVENT_SHOWN || event->window.event == SDL_WINDOWEVENT_RESTORED;
+		case SDL_RENDER_TARGETS_RESET:
+		case SDL_RENDER_DEVICE_RESET:
+			return SDL_TRUE;
+		default:
+			return SDL_FALSE;
+	}
+}
+
+static SDL_bool animate_pause_screen(Game *game)
+{
+	int missile_frame = game->cursor[0].current_frame;
+	int player_frame = game->cursor[1].current_frame;
+	animate_sprite(&game->cursor[0]);
+	animate_sprite(&game->cursor[1]);
+	return missile_frame != game->cursor[0].current_frame || player_frame != game->cursor[1].current_frame;
 }
 
-static int play_game(Game *game)
+static int wait_while_paused(Game *game)
 {
 	SDL_Event event;
-	struct timespec ts;
-	ts.tv_sec = 0;
-	ts.tv_nsec = 100000;
-	Uint32 frame_delay_ticks = (Uint32)((double)SDL_GetPerformanceFrequency() / (double)FPS);
-	Uint64 start_time = SDL_GetPerformanceCounter();
+	SDL_bool redraw = SDL_TRUE;
+	Uint64 frequency = SDL_GetPerformanceFrequency();
+	Uint64 tick_length = frequency / TICK_RATE;
+	Uint64 next_tick = SDL_GetPerformanceCounter() + tick_length;
+	game->cursor[0] = game->player_missile;
+	game->cursor[1] = game->player.sprite;
+
+	while (game->paused) {
+		if (redraw) {
+			draw_pause_screen(game);
+			present_frame(game);
+			redraw = SDL_FALSE;
+		}
 
-	while (1) {
-		if (SDL_PollEvent(&event) != 0) {
-			if (handle_event(game, &event) == 0) {
-				break;
+		Uint64 now = SDL_GetPerformanceCounter();
+		int timeout = now < next_tick ? (int)(((next_tick - now) * 1000 + frequency - 1) / frequency) : 0; /* Round up, a zero timeout only polls. */
+
+		if (SDL_WaitEventTimeout(&event, timeout) != 0) {
+			do {
+				if (handle_event(game, &event) == 0) {
+					return 0;
+				}
+
+				redraw |= event_needs_redraw(&event);
+			} while (game->paused && SDL_PollEvent(&event) != 0);
+		}
+
+		now = SDL_GetPerformanceCounter();
+
+		if (now >= next_tick) { /* The cursor sprites animate at the tick rate. */
+			redraw |= animate_pause_screen(game);
+			next_tick += tick_length;
+
+			if (now >= next_tick) {
+				next_tick = now + tick_length;
 			}
 		}
+	}
 
-		if (game->paused) {
-			SDL_Rect srect = { 0, 0, game->width, game->height };
-			SDL_Rect drect = { 0, 0, game->width, game->height };
+	return 1;
+}
 
-			if (game->pause_screen != NULL) {
-				SDL_RenderCopy(game->renderer, game->pause_screen, &srect, &drect);
-			} else {
-				SDL_RenderCopy(game->renderer, game->background.texture[0], &srect, &drect);
+int play_game(Game *game)
+{
+	Uint64 tick_length = SDL_GetPerformanceFrequency() / TICK_RATE;
+	Uint64 previous_time = SDL_GetPerformanceCounter();
+	Uint64 lag = 0;
+	initialise_pacer(&game->pacer, game->fps);
+
+	while (1) {
+		if (game->paused) {
+			if (wait_while_paused(game) == 0) {
+				break;
 			}
 
-			if (game->lives == 0) {
-				show_game_over_message(game); 
-			}	 
+			previous_time = SDL_GetPerformanceCounter();
+			continue;
+		}
+
+		PROFILE_BEGIN(game, PROFILE_EVENTS);
+		int running = handle_events(game);
+		PROFILE_END(game, PROFILE_EVENTS);
+
+		if (running == 0) {
+			break;
+		}
 
-			show_paused_message(game);
-			SDL_RenderPresent(game->renderer);
-			nanosleep(&ts, NULL);
+		if (game->paused) {
 			continue;
 		}
 
-		if (game->lives == 0) {
+		if (game->lives == 0 && game->replay.mode != REPLAY_PLAY) { /* A replay restarts when the recording did. */
 			game->paused = SDL_TRUE;
+			TRACE_BEGIN(game, "create_pause_screen", NULL);
 			create_pause_screen(game);
+			TRACE_END(game, "create_pause_screen");
+		}
+
+		Uint64 now = SDL_GetPerformanceCounter();
+		lag += now - previous_time;
+		previous_time = now;
+
+		if (lag > MAX_TICKS_PER_FRAME * tick_length) { /* Too far behind, slow the game down rather than spiral. */
+			lag = MAX_TICKS_PER_FRAME * tick_length;
+		}
+
+		while (lag >= tick_length) {
+			update_game(game);
+			lag -= tick_length;
 		}
 
+		if (game->replay.finished) {
+			break;
+		}
+
+		game->alpha = (double)lag / (double)tick_length;
+		begin_scene(game);
+		PROFILE_BEGIN(game, PROFILE_BACKGROUND);
 		draw_background(game);
+		PROFILE_END(game, PROFILE_BACKGROUND);
+		PROFILE_BEGIN(game, PROFILE_RENDER);
 		render_graphics(game);
-		bring_on_others_at_random(game);
-		move_graphics(game);
-		SDL_RenderPresent(game->renderer);
-		Uint64 diff = SDL_GetPerformanceCounter() - start_time;
+		PROFILE_END(game, PROFILE_RENDER);
+		end_scene(game);
+#if defined(PROFILER)
+		draw_profiler(game);
+#endif
+		PROFILE_BEGIN(game, PROFILE_PRESENT);
+		present_frame(game);
+		PROFILE_END(game, PROFILE_PRESENT);
+		PROFILE_BEGIN(game, PROFILE_WAIT);
+		wait_for_next_frame(&game->pacer);
+		PROFILE_END(game, PROFILE_WAIT);
+		PROFILE_FRAME(game);
+	}
+
+	return 0;
+}
+
+int run_headless(Game *game)
+{
+	Uint64 start_time = SDL_GetPerformanceCounter();
+
+	if (game->replay.mode == REPLAY_PLAY) { /* Run the whole recording as fast as possible. */
+		game->frames = ULONG_MAX;
+	}
+
+	for (unsigned long frame = 0; frame < game->frames; frame++) {
+		if (game->lives == 0 && game->replay.mode != REPLAY_PLAY) {
+			restart_after_game_over(game);
+		}
+
+		update_game(game);
+		PROFILE_FRAME(game);
+
+		if (game->replay.finished) {
+			game->frames = frame;
+			break;
+		}
+	}
+
+	double seconds = (double)(SDL_GetPerformanceCounter() - start_time) / (double)SDL_GetPerformanceFrequency();
+	Particles *particles = &game->particles;
+	double ticks_per_microsecond = (double)SDL_GetPerformanceFrequency() / 1000000.0;
+	double particle_average = particles->updates == 0 ? 0.0 : (double)particles->total_ticks / particles->updates / ticks_per_microsecond;
+	double pairs = game->frames == 0 ? 0.0 : (double)game->grid.total_pairs / game->frames;
+	printf("seed=%llu frames=%lu seconds=%.3f fps=%.0f games=%d level=%d score=%d high=%d pairs=%.1f particles_us=%.2f/%.2f startup_ms=%.1f\n", (unsigned long long)game->seed, game->frames, seconds, game->frames / seconds, game->games, game->level, game->score.score, game->score.high, pairs, particle_average, particles->max_ticks / ticks_per_microsecond, game->startup_milliseconds);
+	return 0;
+}
 
-		while (diff < frame_delay_ticks) {
-			nanosleep(&ts, NULL);
-			diff = SDL_GetPerformanceCounter() - start_time;
+static double time_box_kernel(BoxKernel intersect, const Boxes *boxes, const double *queries)
+{
+	volatile Uint64 hits = 0;
+	Uint64 start_time = SDL_GetPerformanceCounter();
+
+	for (int q = 0; q < BENCH_QUERIES; q++) {
+		for (int e = 0; e < BENCH_BOXES; e += 64) {
+			hits += intersect(boxes, e, 64, &queries[q * 4]);
 		}
+	}
 
-		start_time = SDL_GetPerformanceCounter();
+	double seconds = (double)(SDL_GetPerformanceCounter() - start_time) / (double)SDL_GetPerformanceFrequency();
+	return (double)BENCH_BOXES * BENCH_QUERIES / (seconds * 1e9);
+}
+
+int bench_collision(Game *game)
+{
+	Boxes boxes;
+	select_box_kernel(&game->grid);
+	double *queries = (double *)malloc(sizeof(double) * 4 * BENCH_QUERIES);
+	boxes.left = (double *)malloc(sizeof(double) * 4 * BENCH_BOXES);
+
+	if (queries == NULL || boxes.left == NULL) {
+		fprintf(stderr, "%s: malloc returned NULL in function %s\n", GAME_TITLE, __func__);
+		exit(1);
+	}
+
+	boxes.top = boxes.left + BENCH_BOXES;
+	boxes.right = boxes.top + BENCH_BOXES;
+	boxes.bottom = boxes.right + BENCH_BOXES;
+
+	seed_random(&game->random[RANDOM_ALIENS], game->seed, RANDOM_ALIENS);
+
+	for (int i = 0; i < BENCH_BOXES; i++) { /* Alien sized boxes scattered over the playfield. */
+		boxes.left[i] = random_bits(game, RANDOM_ALIENS) % WIDTH;
+		boxes.top[i] = random_bits(game, RANDOM_ALIENS) % HEIGHT;
+		boxes.right[i] = boxes.left[i] + 32;
+		boxes.bottom[i] = boxes.top[i] + 32;
+	}
+
+	for (int q = 0; q < BENCH_QUERIES; q++) {
+		queries[q * 4] = random_bits(game, RANDOM_ALIENS) % WIDTH;
+		queries[q * 4 + 1] = random_bits(game, RANDOM_ALIENS) % HEIGHT;
+		queries[q * 4 + 2] = queries[q * 4] + 32;
+		queries[q * 4 + 3] = queries[q * 4 + 1] + 32;
 	}
 
+	printf("benchmark=collision kernel=scalar boxes_per_ns=%.2f\n", time_box_kernel(intersect_boxes_scalar, &boxes, queries));
+#if defined(__SSE2__)
+	if (SDL_HasSSE2()) {
+		printf("benchmark=collision kernel=sse2 boxes_per_ns=%.2f\n", time_box_kernel(intersect_boxes_sse2, &boxes, queries));
+	}
+#endif
+#if defined(HAVE_AVX2_KERNEL)
+	if (SDL_HasAVX2()) {
+		printf("benchmark=collision kernel=avx2 boxes_per_ns=%.2f\n", time_box_kernel(intersect_boxes_avx2, &boxes, queries));
+	}
+#endif
+	printf("benchmark=collision selected=%s\n", game->grid.kernel_name);
+	free(boxes.left);
+	free(queries);
 	return 0;
 }
 
-static void reset_game(Game *game)
+void reset_game(Game *game)
 {
 	for (int i = 0; i < 7; i++) {
 		game->score.score_digit[i] = 0;
 	}
 
-	game->alien_count = ALIEN_POPULATION;
 	game->level = 1;
 	game->lives = 3;
 	game->score.score = 0;
 	game->score.visible_score = 0;
 	game->alien_type = 1;
+	game->games++;
+	game->player.launcher = 0;
 	reset_aliens(game);
 	reset_bigblue(game);
 	reset_player(game);
@@ -1556,19 +3822,18 @@ static int initialise_textures(Game *game)
 		return 1;
 	}
 
+	create_hud_texture(game);
+	create_scene_textures(game);
 	return 0;
 }
 
 static void free_sprite(Sprite *sprite)
 {
-	for (int i = 0; i < sprite->frame_count; i++) {
-		SDL_DestroyTexture(sprite->texture[i]);
-	}
-
-	free(sprite->texture);
+	free(sprite->frame);
+	free(sprite->mask);
 }
 
-static void free_graphics(Game *game)
+void free_graphics(Game *game)
 {
 	free_sprite(&game->background);
 	free_sprite(&game->explosion);
@@ -1579,21 +3844,34 @@ static void free_graphics(Game *game)
 	free_sprite(&game->asteroid.sprite);
 	free_sprite(&game->bigblue.sprite);
 	free_sprite(&game->player.sprite);
-	free_sprite(&game->debris.upper_left.sprite);
-	free_sprite(&game->debris.upper_right.sprite);
-	free_sprite(&game->debris.lower_left.sprite);
-	free_sprite(&game->debris.lower_right.sprite);
+
+	for (int i = 0; i < 4; i++) {
+		free_sprite(&game->quarter[i]);
+	}
+
 	SDL_DestroyTexture(game->pause_screen);
 	SDL_DestroyTexture(game->game_over_message);
 
 	for (int i = 0; i < ALIEN_TYPE; i++) {
-		for (int j = 0; j < ALIEN_POPULATION; j++) {
-			free(game->alien[i][j].sprite.texture);
-		}
-
 		free_sprite(&game->alien_sprite[i]);
 	}
 
+#if defined(PROFILER)
+	free_profiler(&game->profiler);
+#endif
+	free_alien_store(&game->aliens);
+	free_grid(&game->grid);
+	free_atlas(&game->atlas);
+
+	if (game->headless) {
+		IMG_Quit();
+		SDL_Quit();
+		return;
+	}
+
+	SDL_DestroyTexture(game->hud.texture);
+	SDL_DestroyTexture(game->scene);
+
 	for (int i = 0; i < 10; i++) {
 		SDL_DestroyTexture(game->score.digit_texture[i]);
 	}
@@ -1605,34 +3883,126 @@ static void free_graphics(Game *game)
 	SDL_DestroyRenderer(game->renderer);
 	SDL_DestroyWindow(game->window);
 	TTF_Quit();
+	IMG_Quit();
 	SDL_Quit();
 }
 
-int main(int argc, char *argv[])
+void set_default_options(Options *options)
 {
-	Game game;
-	int status = initialise_game(&game);
+	options->bench_collision = SDL_FALSE;
+	options->headless = SDL_FALSE;
+	options->latency = SDL_FALSE;
+	options->vsync = SDL_FALSE;
+	options->profile_path = NULL;
+	options->trace_path = NULL;
+	options->replay_path = NULL;
+	options->alien_count = ALIEN_POPULATION;
+	options->fps = -1; /* Display refresh rate. */
+	options->replay_mode = REPLAY_OFF;
+	options->shot_limit = 1;
+	options->frames = HEADLESS_FRAMES;
+	options->seed = RANDOM_SEED;
+}
 
-	if (status != 0) {
+Game *create_game(const Options *options)
+{
+	Game *game = (Game *)calloc(1, sizeof(Game));
+
+	if (game == NULL) {
+		fprintf(stderr, "%s: calloc returned NULL in function %s\n", GAME_TITLE, __func__);
+		exit(1);
+	}
+
+	game->headless = options->headless;
+	game->frames = options->frames;
+	game->fps = options->fps;
+	game->vsync = options->vsync;
+	game->latency.enabled = options->latency;
+	game->latency.pending_count = 0;
+	game->latency.sample_count = 0;
+	game->latency.ticks = 0;
+	game->alien_count = options->alien_count;
+	game->shot_limit = options->shot_limit;
+	game->seed = options->seed;
+	game->replay.mode = options->replay_mode;
+	game->replay.file = NULL;
+	game->replay.path = options->replay_path;
+	game->replay.finished = SDL_FALSE;
+	game->replay.pending = game->replay.state = 0;
+	game->replay.run = game->replay.ticks = 0;
+	game->replay.recorded_ticks = game->replay.recorded_score = 0;
+#if defined(PROFILER)
+	game->profiler.visible = SDL_FALSE;
+	game->profiler.path = options->profile_path;
+	game->tracer.path = options->trace_path;
+	game->tracer.file = NULL;
+#endif
+	return game;
+}
+
+int start_game(Game *game)
+{
+	if (open_replay(game) != 0) {
 		return 1;
 	}
 
-	initialise_audio(&game);
+#if defined(PROFILER)
+	if (open_trace(game) != 0) {
+		discard_replay(game);
+		return 1;
+	}
+#endif
+
+	if (initialise_game(game) != 0) {
+#if defined(PROFILER)
+		close_trace(game);
+#endif
+		discard_replay(game);
+		return 1;
+	}
 
-	if (game.audio.id != 0) {
-		load_audio(&game, DATADIR"/explode.wav");
+	if (game->headless) {
+		return 0;
 	}
 
-	SDL_ShowCursor(SDL_DISABLE);
-	play_game(&game);
-	SDL_ShowCursor(SDL_ENABLE);
-	TTF_CloseFont(game.font);
+	initialise_audio(game);
 
-	if (game.audio.id != 0) {
-		close_audio(&game);
+	if (game->audio.id != 0) {
+		load_audio(game, DATADIR"/explode.wav");
 	}
 
-	free_graphics(&game);
+	SDL_ShowCursor(SDL_DISABLE);
 	return 0;
 }
 
+int run_game(Game *game)
+{
+	return game->headless ? run_headless(game) : play_game(game);
+}
+
+void stop_game(Game *game)
+{
+	close_replay(game);
+#if defined(PROFILER)
+	export_profile(game);
+	close_trace(game);
+#endif
+
+	if (!game->headless) {
+		SDL_ShowCursor(SDL_ENABLE);
+		printf("startup_ms=%.1f\n", game->startup_milliseconds); /* A headless run has it in its summary. */
+		report_latency(game);
+		TTF_CloseFont(game->font);
+
+		if (game->audio.id != 0) {
+			close_audio(game);
+		}
+	}
+
+	free_graphics(game);
+}
+
+void destroy_game(Game *game)
+{
+	free(game);
+}
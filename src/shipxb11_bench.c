@@ -0,0 +1,168 @@
+/*
+	shipxb11
+	Copyright (C) 2022 Craig McPartland
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+	A fixed benchmark suite. Every result is one line of key=value pairs
+	on stdout, so runs from different releases can be compared by script.
+*/
+
+#include "game.h"
+
+static double seconds_since(Uint64 start_time)
+{
+	return (double)(SDL_GetPerformanceCounter() - start_time) / (double)SDL_GetPerformanceFrequency();
+}
+
+static int bench_simulation(int alien_count)
+{
+	Options options;
+	set_default_options(&options);
+	options.headless = SDL_TRUE;
+	options.alien_count = alien_count;
+	options.shot_limit = 4;
+	Game *game = create_game(&options);
+
+	if (initialise_game(game) != 0) {
+		destroy_game(game);
+		return 1;
+	}
+
+	if (alien_count == ALIEN_POPULATION) { /* Loading does not depend on the wave size. */
+		printf("benchmark=startup milliseconds=%.3f decode_threads=%d\n", game->startup_milliseconds, SDL_min(SDL_max(SDL_GetCPUCount(), 1), DECODE_THREADS));
+	}
+
+	unsigned long ticks = 0;
+	Uint64 start_time = SDL_GetPerformanceCounter();
+
+	do { /* The same scripted player every run: fire constantly and sweep from side to side. */
+		for (int i = 0; i < 1000; i++, ticks++) {
+			if (game->lives == 0) {
+				restart_after_game_over(game);
+			}
+
+			launch_missile(game);
+			game->player.key = (ticks % 301) < 150 ? LEFT_KEY : RIGHT_KEY;
+			update_game(game);
+		}
+	} while (seconds_since(start_time) < BENCH_SECONDS);
+
+	double seconds = seconds_since(start_time);
+	printf("benchmark=simulation aliens=%d ticks=%lu ticks_per_second=%.0f pairs_per_tick=%.1f\n", alien_count, ticks, ticks / seconds, (double)game->grid.total_pairs / ticks);
+	free_graphics(game);
+	destroy_game(game);
+	return 0;
+}
+
+static int bench_batch(void)
+{
+	Options options;
+	set_default_options(&options);
+	Game *game = create_game(&options); /* Zeroed, so only the batch and renderer need setting up. */
+	SDL_Surface *target = SDL_CreateRGBSurface(0, WIDTH, HEIGHT, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000);
+	SDL_Surface *image = SDL_CreateRGBSurface(0, 64, 64, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000);
+
+	if (target == NULL || image == NULL) {
+		fprintf(stderr, "%s: %s\n", GAME_TITLE, SDL_GetError());
+		destroy_game(game);
+		return 1;
+	}
+
+	game->renderer = SDL_CreateSoftwareRenderer(target);
+	SDL_Texture *texture = game->renderer == NULL ? NULL : SDL_CreateTextureFromSurface(game->renderer, image);
+
+	if (texture == NULL) {
+		fprintf(stderr, "%s: %s\n", GAME_TITLE, SDL_GetError());
+		destroy_game(game);
+		return 1;
+	}
+
+	initialise_batch(&game->batch);
+	SDL_Rect srect = { 0, 0, 32, 32 };
+	Uint64 start_time = SDL_GetPerformanceCounter();
+
+	for (int i = 0; i < BENCH_QUADS; i++) { /* Submission only, the software renderer draws nothing of note at this size. */
+		SDL_Rect drect = { i % (WIDTH - 32), (i / WIDTH) % (HEIGHT - 32), 1, 1 };
+		batch_copy(game, texture, &srect, &drect);
+	}
+
+	flush_batch(game);
+	double seconds = seconds_since(start_time);
+	printf("benchmark=batch quads=%d nanoseconds_per_quad=%.2f\n", BENCH_QUADS, seconds * 1e9 / BENCH_QUADS);
+	SDL_DestroyTexture(texture);
+	SDL_DestroyRenderer(game->renderer);
+	SDL_FreeSurface(image);
+	SDL_FreeSurface(target);
+	destroy_game(game);
+	return 0;
+}
+
+static int bench_audio(void)
+{
+	Options options;
+	set_default_options(&options);
+	Game *game = create_game(&options);
+	Uint64 bytes = 0;
+	game->audio.device_spec.freq = 48000; /* Unlike the sample, so every load converts. */
+	game->audio.device_spec.format = AUDIO_F32;
+	game->audio.device_spec.channels = 2;
+	Uint64 start_time = SDL_GetPerformanceCounter();
+
+	for (int i = 0; i < BENCH_SOUNDS; i++) {
+		game->audio.index = 0;
+
+		if (load_audio(game, DATADIR"/explode.wav") != 0) {
+			fprintf(stderr, "%s: %s\n", GAME_TITLE, SDL_GetError());
+			destroy_game(game);
+			return 1;
+		}
+
+		bytes += game->audio.audio_info[0].wave_length;
+		close_audio(game);
+	}
+
+	double seconds = seconds_since(start_time);
+	printf("benchmark=audio loads=%d megabytes_per_second=%.1f\n", BENCH_SOUNDS, bytes / seconds / 1e6);
+	destroy_game(game);
+	return 0;
+}
+
+int main(void)
+{
+	int wave[] = { ALIEN_POPULATION, 100, 1000 };
+	int status = 0;
+
+	for (int i = 0; i < 3 && status == 0; i++) {
+		status = bench_simulation(wave[i]);
+	}
+
+	if (status == 0) {
+		Options options;
+		set_default_options(&options);
+		Game *game = create_game(&options);
+		status = bench_collision(game);
+		destroy_game(game);
+	}
+
+	if (status == 0 && SDL_Init(0) == 0) {
+		status = bench_batch();
+		status |= bench_audio();
+		SDL_Quit();
+	}
+
+	return status;
+}